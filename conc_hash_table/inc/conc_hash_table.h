@@ -0,0 +1,81 @@
+#ifndef CONC_HASH_TABLE_H
+#define CONC_HASH_TABLE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../../hash_table/inc/hash_table.h"
+
+#define CONC_HASH_TABLE_DEFAULT_STRIPES (64U)
+#define CONC_HASH_TABLE_CACHE_LINE (64U)
+
+// flags for conc_hash_table_create_ex
+#define CONC_HASH_TABLE_LOCKFREE_READS (1U << 0) // searches take no locks; freed nodes are recycled only after every reader has moved on
+
+// a node unlinked while lock-free readers may still be walking through it
+typedef struct
+{
+    node_t *node;
+    uint64_t epoch; // global epoch at the time it was unlinked
+} conc_retired_t;
+
+// one lock stripe; a key always maps to the same stripe, whatever the bucket count
+// bucket b belongs to stripe (b & (num_of_stripes - 1)), so the stripe also owns every node in those chains
+typedef struct
+{
+    _Alignas(CONC_HASH_TABLE_CACHE_LINE) pthread_rwlock_t lock;
+    node_t *free_nodes;  // nodes freed from this stripe's chains, guarded by lock
+    hash_arena_t arena;  // slabs for this stripe's nodes, guarded by lock
+    size_t num_of_nodes; // live nodes in this stripe's chains, guarded by lock
+
+    // nodes waiting for a grace period before they go back on free_nodes, guarded by lock
+    // epochs only grow, so the list is ordered oldest first
+    conc_retired_t *limbo;
+    size_t limbo_len;
+    size_t limbo_cap;
+} conc_stripe_t;
+
+// the bucket count travels with the array so lock-free readers always see a matching pair
+typedef struct conc_buckets
+{
+    size_t num_of_buckets;             // always a power of two and never below num_of_stripes
+    struct conc_buckets *retired_next; // arrays replaced by a resize, kept until readers move on
+    uint64_t retire_epoch;
+    node_t *buckets[];
+} conc_buckets_t;
+
+typedef struct
+{
+    size_t key_size;
+    size_t value_size;
+    uint32_t flags;
+    hash_fn_t hash_fn; // HASH_FN_DEFAULT; the low bits pick both the stripe and the bucket
+    uint64_t seed;
+
+    conc_buckets_t *array;          // replaced only with every stripe write-locked
+    conc_buckets_t *retired_arrays; // guarded by holding every stripe
+
+    size_t num_of_stripes; // always a power of two
+    conc_stripe_t *stripes;
+} conc_hash_table_t;
+
+// same chained-bucket design as hash_table_t, but safe to call from many threads at once
+// operations on keys in different stripes run in parallel; searches in the same stripe share a read lock
+// num_of_stripes of 0 picks CONC_HASH_TABLE_DEFAULT_STRIPES; both counts are rounded up to powers of two
+conc_hash_table_t *conc_hash_table_create(size_t num_of_buckets, size_t key_size, size_t value_size, size_t num_of_stripes);
+
+// with CONC_HASH_TABLE_LOCKFREE_READS, conc_hash_table_search never touches a lock word:
+// chains are published with release stores, overwrites replace the node instead of rewriting it in place,
+// and unlinked nodes (and bucket arrays left behind by a resize) are reclaimed through epochs
+// writers still serialize on their stripe lock
+conc_hash_table_t *conc_hash_table_create_ex(size_t num_of_buckets, size_t key_size, size_t value_size, size_t num_of_stripes, uint32_t flags);
+void conc_hash_table_destroy(conc_hash_table_t *table); // must not race with any other call on the table
+
+bool conc_hash_table_insert(conc_hash_table_t *table, const void *key, const void *value);
+bool conc_hash_table_delete(conc_hash_table_t *table, const void *key);
+bool conc_hash_table_search(conc_hash_table_t *table, const void *key, void *value);
+size_t conc_hash_table_size(conc_hash_table_t *table); // a snapshot; may be stale by the time it returns
+
+#endif
@@ -0,0 +1,665 @@
+#include "../inc/conc_hash_table.h"
+
+#include <string.h>
+#include <sched.h>
+
+#define BUCKET_DOUBLING_CUTOFF (0.3)
+
+#define EBR_MAX_THREADS (256U)        // threads beyond this fall back to the stripe read lock
+#define LIMBO_RECLAIM_THRESHOLD (64U) // retired nodes a stripe collects before trying to recycle them
+
+static inline uint64_t conc_hash_table_hash(const conc_hash_table_t *table, const void *key)
+{
+    return table->hash_fn(key, table->key_size, table->seed);
+}
+
+// epoch-based reclamation, shared by every table in the process
+// a reader publishes the global epoch it started in; a node retired in epoch e is only recycled
+// once every reader still inside a read section started after e
+typedef struct
+{
+    _Alignas(CONC_HASH_TABLE_CACHE_LINE) uint64_t epoch; // 0 while the owning thread is not reading
+    bool in_use;
+} ebr_slot_t;
+
+static ebr_slot_t ebr_slots[EBR_MAX_THREADS];
+static uint64_t ebr_global_epoch = 1;
+static pthread_once_t ebr_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ebr_key;
+static _Thread_local ebr_slot_t *ebr_self;
+
+// runs at thread exit so the slot can be handed to another thread
+static void ebr_release_slot(void *arg)
+{
+    ebr_slot_t *slot = (ebr_slot_t *)arg;
+    __atomic_store_n(&slot->epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&slot->in_use, false, __ATOMIC_RELEASE);
+}
+
+static void ebr_init(void)
+{
+    pthread_key_create(&ebr_key, ebr_release_slot);
+}
+
+static ebr_slot_t *ebr_register(void)
+{
+    if (ebr_self)
+        return ebr_self;
+
+    pthread_once(&ebr_once, ebr_init);
+
+    for (size_t index = 0; index < EBR_MAX_THREADS; index++)
+    {
+        bool expected = false;
+        if (__atomic_compare_exchange_n(&ebr_slots[index].in_use, &expected, true, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        {
+            ebr_self = &ebr_slots[index];
+            pthread_setspecific(ebr_key, ebr_self);
+            return ebr_self;
+        }
+    }
+
+    return NULL;
+}
+
+// returns false if no slot is left, in which case the caller must read under the stripe lock
+static bool ebr_enter(void)
+{
+    ebr_slot_t *slot = ebr_register();
+    if (!slot)
+        return false;
+
+    __atomic_store_n(&slot->epoch, __atomic_load_n(&ebr_global_epoch, __ATOMIC_SEQ_CST), __ATOMIC_RELAXED);
+
+    // pairs with the fence in ebr_safe_epoch: either a reclaimer sees our epoch, or we see its unlinks
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return true;
+}
+
+static void ebr_exit(void)
+{
+    __atomic_store_n(&ebr_self->epoch, 0, __ATOMIC_RELEASE);
+}
+
+// the epoch to tag something with once it has been unlinked
+static uint64_t ebr_retire_epoch(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_load_n(&ebr_global_epoch, __ATOMIC_SEQ_CST);
+}
+
+// advances the global epoch and returns the oldest epoch a reader may still be in
+// anything retired with epoch + 1 < the result can no longer be reached by any reader
+static uint64_t ebr_safe_epoch(void)
+{
+    uint64_t safe = __atomic_add_fetch(&ebr_global_epoch, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for (size_t index = 0; index < EBR_MAX_THREADS; index++)
+    {
+        if (!__atomic_load_n(&ebr_slots[index].in_use, __ATOMIC_ACQUIRE))
+            continue;
+
+        uint64_t epoch = __atomic_load_n(&ebr_slots[index].epoch, __ATOMIC_ACQUIRE);
+        if (epoch && epoch < safe)
+            safe = epoch;
+    }
+
+    return safe;
+}
+
+static size_t round_up_pow2(size_t n)
+{
+    size_t pow = 1;
+    while (pow < n)
+        pow <<= 1;
+    return pow;
+}
+
+static conc_buckets_t *conc_buckets_create(size_t num_of_buckets)
+{
+    conc_buckets_t *array = calloc(1, sizeof(conc_buckets_t) + num_of_buckets * sizeof(node_t *));
+    if (!array)
+        return NULL;
+
+    array->num_of_buckets = num_of_buckets;
+    array->retired_next = NULL;
+    array->retire_epoch = 0;
+    return array;
+}
+
+conc_hash_table_t *conc_hash_table_create(size_t num_of_buckets, size_t key_size, size_t value_size, size_t num_of_stripes)
+{
+    return conc_hash_table_create_ex(num_of_buckets, key_size, value_size, num_of_stripes, 0);
+}
+
+conc_hash_table_t *conc_hash_table_create_ex(size_t num_of_buckets, size_t key_size, size_t value_size, size_t num_of_stripes, uint32_t flags)
+{
+    if (!num_of_buckets || !key_size || !value_size)
+        return NULL;
+
+    conc_hash_table_t *table = malloc(sizeof(conc_hash_table_t));
+    if (!table)
+        return NULL;
+
+    if (!num_of_stripes)
+        num_of_stripes = CONC_HASH_TABLE_DEFAULT_STRIPES;
+    num_of_stripes = round_up_pow2(num_of_stripes);
+
+    num_of_buckets = round_up_pow2(num_of_buckets);
+    if (num_of_buckets < num_of_stripes)
+        num_of_buckets = num_of_stripes;
+
+    table->array = conc_buckets_create(num_of_buckets);
+    if (!table->array)
+    {
+        free(table);
+        return NULL;
+    }
+
+    // stripes are cache-line aligned so that neighbouring locks don't share a line
+    table->stripes = aligned_alloc(CONC_HASH_TABLE_CACHE_LINE, num_of_stripes * sizeof(conc_stripe_t));
+    if (!table->stripes)
+    {
+        free(table->array);
+        free(table);
+        return NULL;
+    }
+
+    for (size_t index = 0; index < num_of_stripes; index++)
+    {
+        conc_stripe_t *stripe = &table->stripes[index];
+        if (pthread_rwlock_init(&stripe->lock, NULL))
+        {
+            for (size_t counter = 0; counter < index; counter++)
+            {
+                pthread_rwlock_destroy(&table->stripes[counter].lock);
+            }
+            free(table->stripes);
+            free(table->array);
+            free(table);
+            return NULL;
+        }
+
+        stripe->free_nodes = NULL;
+        stripe->num_of_nodes = 0;
+        stripe->limbo = NULL;
+        stripe->limbo_len = 0;
+        stripe->limbo_cap = 0;
+        hash_arena_init(&stripe->arena, key_size, value_size);
+    }
+
+    table->num_of_stripes = num_of_stripes;
+    table->key_size = key_size;
+    table->value_size = value_size;
+    table->flags = flags;
+    table->hash_fn = HASH_FN_DEFAULT;
+    table->seed = HASH_DEFAULT_SEED;
+    table->retired_arrays = NULL;
+
+    return table;
+}
+
+void conc_hash_table_destroy(conc_hash_table_t *table)
+{
+    if (!table)
+        return;
+
+    // every node, including the ones still in limbo, lives in one of the stripes' slabs
+    for (size_t index = 0; index < table->num_of_stripes; index++)
+    {
+        hash_arena_free(&table->stripes[index].arena);
+        free(table->stripes[index].limbo);
+        pthread_rwlock_destroy(&table->stripes[index].lock);
+    }
+
+    conc_buckets_t *array = table->retired_arrays;
+    while (array)
+    {
+        conc_buckets_t *next = array->retired_next;
+        free(array);
+        array = next;
+    }
+
+    free(table->stripes);
+    free(table->array);
+    free(table);
+}
+
+static inline conc_stripe_t *conc_stripe_of(conc_hash_table_t *table, uint64_t hash)
+{
+    return &table->stripes[hash & (table->num_of_stripes - 1)];
+}
+
+static node_t *conc_stripe_alloc(conc_stripe_t *stripe)
+{
+    node_t *node = stripe->free_nodes;
+    if (node)
+    {
+        stripe->free_nodes = node->next;
+        return node;
+    }
+
+    return hash_arena_alloc(&stripe->arena);
+}
+
+static void conc_stripe_recycle(conc_stripe_t *stripe, node_t *node)
+{
+    node->is_free = true;
+    node->next = stripe->free_nodes;
+    stripe->free_nodes = node;
+}
+
+// moves every limbo node that no reader can reach anymore onto the free list
+// caller holds the stripe's write lock
+static void conc_stripe_reclaim(conc_stripe_t *stripe)
+{
+    if (!stripe->limbo_len)
+        return;
+
+    uint64_t safe = ebr_safe_epoch();
+
+    size_t done = 0;
+    while (done < stripe->limbo_len && stripe->limbo[done].epoch + 1 < safe)
+    {
+        conc_stripe_recycle(stripe, stripe->limbo[done].node);
+        done++;
+    }
+
+    memmove(stripe->limbo, stripe->limbo + done, (stripe->limbo_len - done) * sizeof(conc_retired_t));
+    stripe->limbo_len -= done;
+}
+
+static bool conc_stripe_reserve_limbo(conc_stripe_t *stripe, size_t extra)
+{
+    if (stripe->limbo_len + extra <= stripe->limbo_cap)
+        return true;
+
+    size_t new_cap = stripe->limbo_cap ? stripe->limbo_cap : LIMBO_RECLAIM_THRESHOLD;
+    while (new_cap < stripe->limbo_len + extra)
+        new_cap <<= 1;
+
+    conc_retired_t *limbo = realloc(stripe->limbo, new_cap * sizeof(conc_retired_t));
+    if (!limbo)
+        return false;
+
+    stripe->limbo = limbo;
+    stripe->limbo_cap = new_cap;
+    return true;
+}
+
+// hands an unlinked node back to its stripe
+// with lock-free readers it has to sit in limbo until they can no longer be looking at it
+// caller holds the stripe's write lock
+static void conc_stripe_retire(conc_hash_table_t *table, conc_stripe_t *stripe, node_t *node)
+{
+    if (!(table->flags & CONC_HASH_TABLE_LOCKFREE_READS))
+    {
+        conc_stripe_recycle(stripe, node);
+        return;
+    }
+
+    uint64_t epoch = ebr_retire_epoch();
+
+    if (!conc_stripe_reserve_limbo(stripe, 1))
+    {
+        // no room to defer it, so wait out the readers right here
+        while (!(epoch + 1 < ebr_safe_epoch()))
+        {
+            sched_yield();
+        }
+        conc_stripe_recycle(stripe, node);
+        return;
+    }
+
+    stripe->limbo[stripe->limbo_len].node = node;
+    stripe->limbo[stripe->limbo_len].epoch = epoch;
+    stripe->limbo_len++;
+
+    if (stripe->limbo_len >= LIMBO_RECLAIM_THRESHOLD)
+        conc_stripe_reclaim(stripe);
+}
+
+// relinks every node into the new array; only valid when readers take the stripe locks
+static void conc_hash_table_relink(conc_buckets_t *old_array, conc_buckets_t *new_array)
+{
+    for (size_t i = 0; i < old_array->num_of_buckets; i++)
+    {
+        node_t *current = old_array->buckets[i];
+        while (current)
+        {
+            node_t *next = current->next;
+
+            size_t new_hash = current->hash & (new_array->num_of_buckets - 1);
+            current->next = new_array->buckets[new_hash];
+            new_array->buckets[new_hash] = current;
+
+            current = next;
+        }
+    }
+}
+
+// builds the new array out of copies so that lock-free readers still walking the old chains see them intact
+// the originals are retired once the new array is published
+static bool conc_hash_table_clone(conc_hash_table_t *table, conc_buckets_t *old_array, conc_buckets_t *new_array)
+{
+    // reserve limbo space up front so retiring the originals below cannot fail halfway
+    for (size_t index = 0; index < table->num_of_stripes; index++)
+    {
+        conc_stripe_t *stripe = &table->stripes[index];
+        if (!conc_stripe_reserve_limbo(stripe, stripe->num_of_nodes))
+            return false;
+    }
+
+    for (size_t i = 0; i < old_array->num_of_buckets; i++)
+    {
+        for (node_t *current = old_array->buckets[i]; current; current = current->next)
+        {
+            uint64_t hash = current->hash;
+            node_t *copy = conc_stripe_alloc(conc_stripe_of(table, hash));
+            if (!copy)
+            {
+                // give back the copies made so far; nothing has been published yet
+                for (size_t j = 0; j < new_array->num_of_buckets; j++)
+                {
+                    node_t *node = new_array->buckets[j];
+                    while (node)
+                    {
+                        node_t *next = node->next;
+                        conc_stripe_recycle(conc_stripe_of(table, node->hash), node);
+                        node = next;
+                    }
+                }
+                return false;
+            }
+
+            memcpy(copy->key, current->key, table->key_size);
+            memcpy(copy->value, current->value, table->value_size);
+            copy->is_free = false;
+            copy->hash = hash;
+
+            size_t new_hash = hash & (new_array->num_of_buckets - 1);
+            copy->next = new_array->buckets[new_hash];
+            new_array->buckets[new_hash] = copy;
+        }
+    }
+
+    __atomic_store_n(&table->array, new_array, __ATOMIC_RELEASE);
+
+    uint64_t epoch = ebr_retire_epoch();
+
+    for (size_t i = 0; i < old_array->num_of_buckets; i++)
+    {
+        for (node_t *current = old_array->buckets[i]; current; current = current->next)
+        {
+            conc_stripe_t *stripe = conc_stripe_of(table, current->hash);
+            stripe->limbo[stripe->limbo_len].node = current;
+            stripe->limbo[stripe->limbo_len].epoch = epoch;
+            stripe->limbo_len++;
+        }
+    }
+
+    old_array->retire_epoch = epoch;
+    old_array->retired_next = table->retired_arrays;
+    table->retired_arrays = old_array;
+
+    return true;
+}
+
+// frees bucket arrays left behind by earlier resizes that no reader can still be using
+// caller holds every stripe
+static void conc_hash_table_reclaim_arrays(conc_hash_table_t *table)
+{
+    if (!table->retired_arrays)
+        return;
+
+    uint64_t safe = ebr_safe_epoch();
+
+    conc_buckets_t **link = &table->retired_arrays;
+    while (*link)
+    {
+        conc_buckets_t *array = *link;
+        if (array->retire_epoch + 1 < safe)
+        {
+            *link = array->retired_next;
+            free(array);
+        }
+        else
+        {
+            link = &array->retired_next;
+        }
+    }
+}
+
+// doubles the bucket array with every stripe write-locked
+// seen_buckets is the bucket count the caller saw; if someone else already grew the table, nothing happens
+static bool conc_hash_table_grow(conc_hash_table_t *table, size_t seen_buckets)
+{
+    // stripes are always taken in index order, so two growing threads cannot deadlock
+    for (size_t index = 0; index < table->num_of_stripes; index++)
+    {
+        pthread_rwlock_wrlock(&table->stripes[index].lock);
+    }
+
+    bool result = true;
+    conc_buckets_t *old_array = table->array;
+
+    if (old_array->num_of_buckets == seen_buckets)
+    {
+        conc_buckets_t *new_array = conc_buckets_create(seen_buckets * 2);
+        if (!new_array)
+        {
+            result = false;
+        }
+        else if (table->flags & CONC_HASH_TABLE_LOCKFREE_READS)
+        {
+            conc_hash_table_reclaim_arrays(table);
+
+            if (!conc_hash_table_clone(table, old_array, new_array))
+            {
+                free(new_array);
+                result = false;
+            }
+        }
+        else
+        {
+            // a node's stripe is fixed by the low bits of its hash, so relinking never moves it across stripes
+            conc_hash_table_relink(old_array, new_array);
+            table->array = new_array;
+            free(old_array);
+        }
+    }
+
+    for (size_t index = table->num_of_stripes; index > 0; index--)
+    {
+        pthread_rwlock_unlock(&table->stripes[index - 1].lock);
+    }
+
+    return result;
+}
+
+bool conc_hash_table_insert(conc_hash_table_t *table, const void *key, const void *value)
+{
+    if (!table || !key || !value)
+        return false;
+
+    uint64_t hash = conc_hash_table_hash(table, key);
+    conc_stripe_t *stripe = conc_stripe_of(table, hash);
+
+    pthread_rwlock_wrlock(&stripe->lock);
+
+    conc_buckets_t *array = table->array;
+    node_t **prev = &array->buckets[hash & (array->num_of_buckets - 1)];
+    node_t *current = *prev;
+
+    while (current)
+    {
+        if (current->hash == hash && !memcmp(current->key, key, table->key_size))
+            break;
+
+        prev = &current->next;
+        current = current->next;
+    }
+
+    if (current && !(table->flags & CONC_HASH_TABLE_LOCKFREE_READS))
+    {
+        memcpy(current->value, value, table->value_size);
+        pthread_rwlock_unlock(&stripe->lock);
+        return true;
+    }
+
+    node_t *new_node = conc_stripe_alloc(stripe);
+    if (!new_node)
+    {
+        pthread_rwlock_unlock(&stripe->lock);
+        return false;
+    }
+
+    memcpy(new_node->key, key, table->key_size);
+    memcpy(new_node->value, value, table->value_size);
+    new_node->is_free = false;
+    new_node->hash = hash;
+
+    if (current)
+    {
+        // a lock-free reader may be copying the old value, so swap in a fresh node instead of rewriting it
+        new_node->next = current->next;
+        __atomic_store_n(prev, new_node, __ATOMIC_RELEASE);
+        conc_stripe_retire(table, stripe, current);
+
+        pthread_rwlock_unlock(&stripe->lock);
+        return true;
+    }
+
+    // the node is fully written before the release store makes it reachable
+    node_t **bucket = &array->buckets[hash & (array->num_of_buckets - 1)];
+    new_node->next = *bucket;
+    __atomic_store_n(bucket, new_node, __ATOMIC_RELEASE);
+
+    // each stripe owns num_of_buckets / num_of_stripes buckets, so it checks its own share of the load
+    size_t num_of_buckets = array->num_of_buckets;
+    bool needs_growth = ++stripe->num_of_nodes >= BUCKET_DOUBLING_CUTOFF * (num_of_buckets / table->num_of_stripes);
+
+    // a resize can leave a whole stripe's worth of nodes in limbo; recycle them as writers pass by
+    if (stripe->limbo_len >= LIMBO_RECLAIM_THRESHOLD)
+        conc_stripe_reclaim(stripe);
+
+    pthread_rwlock_unlock(&stripe->lock);
+
+    if (needs_growth)
+    {
+        if (!conc_hash_table_grow(table, num_of_buckets))
+        {
+            // growing failed will lead to a performance degrade
+        }
+    }
+
+    return true;
+}
+
+bool conc_hash_table_delete(conc_hash_table_t *table, const void *key)
+{
+    if (!table || !key)
+        return false;
+
+    uint64_t hash = conc_hash_table_hash(table, key);
+    conc_stripe_t *stripe = conc_stripe_of(table, hash);
+
+    pthread_rwlock_wrlock(&stripe->lock);
+
+    conc_buckets_t *array = table->array;
+    node_t **prev = &array->buckets[hash & (array->num_of_buckets - 1)];
+    node_t *current = *prev;
+
+    while (current)
+    {
+        if (current->hash == hash && !memcmp(current->key, key, table->key_size))
+        {
+            // the unlinked node keeps its next pointer, so a reader standing on it can carry on
+            __atomic_store_n(prev, current->next, __ATOMIC_RELEASE);
+            conc_stripe_retire(table, stripe, current);
+
+            stripe->num_of_nodes--;
+
+            pthread_rwlock_unlock(&stripe->lock);
+            return true;
+        }
+
+        prev = &current->next;
+        current = current->next;
+    }
+
+    pthread_rwlock_unlock(&stripe->lock);
+    return false;
+}
+
+static bool conc_hash_table_search_locked(conc_hash_table_t *table, const void *key, void *value, uint64_t hash)
+{
+    conc_stripe_t *stripe = conc_stripe_of(table, hash);
+
+    pthread_rwlock_rdlock(&stripe->lock);
+
+    conc_buckets_t *array = table->array;
+    node_t *current = array->buckets[hash & (array->num_of_buckets - 1)];
+    while (current)
+    {
+        if (current->hash == hash && !memcmp(current->key, key, table->key_size))
+        {
+            memcpy(value, current->value, table->value_size);
+            pthread_rwlock_unlock(&stripe->lock);
+            return true;
+        }
+        current = current->next;
+    }
+
+    pthread_rwlock_unlock(&stripe->lock);
+    return false;
+}
+
+bool conc_hash_table_search(conc_hash_table_t *table, const void *key, void *value)
+{
+    if (!table || !key || !value)
+        return false;
+
+    uint64_t hash = conc_hash_table_hash(table, key);
+
+    if (!(table->flags & CONC_HASH_TABLE_LOCKFREE_READS) || !ebr_enter())
+        return conc_hash_table_search_locked(table, key, value, hash);
+
+    // nothing reachable from here is recycled until ebr_exit, and nothing reachable is ever modified in place
+    conc_buckets_t *array = __atomic_load_n(&table->array, __ATOMIC_ACQUIRE);
+    node_t *current = __atomic_load_n(&array->buckets[hash & (array->num_of_buckets - 1)], __ATOMIC_ACQUIRE);
+
+    bool found = false;
+    while (current)
+    {
+        if (current->hash == hash && !memcmp(current->key, key, table->key_size))
+        {
+            memcpy(value, current->value, table->value_size);
+            found = true;
+            break;
+        }
+        current = __atomic_load_n(&current->next, __ATOMIC_ACQUIRE);
+    }
+
+    ebr_exit();
+    return found;
+}
+
+size_t conc_hash_table_size(conc_hash_table_t *table)
+{
+    if (!table)
+        return 0;
+
+    size_t total = 0;
+    for (size_t index = 0; index < table->num_of_stripes; index++)
+    {
+        conc_stripe_t *stripe = &table->stripes[index];
+
+        pthread_rwlock_rdlock(&stripe->lock);
+        total += stripe->num_of_nodes;
+        pthread_rwlock_unlock(&stripe->lock);
+    }
+
+    return total;
+}
@@ -0,0 +1,59 @@
+#ifndef CONC_MAP_H
+#define CONC_MAP_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../../map/inc/map.h"
+
+#define CONC_MAP_DEFAULT_SHARDS (64U)
+#define CONC_MAP_CACHE_LINE (64U)
+
+// one shard is a whole map_t behind its own lock; a key always maps to the same shard
+typedef struct
+{
+    _Alignas(CONC_MAP_CACHE_LINE) pthread_rwlock_t lock;
+    map_t *map; // guarded by lock; grows on its own, so a resize only stalls this shard's keys
+} conc_map_shard_t;
+
+typedef struct
+{
+    size_t key_size; // 0 for a map made by conc_map_create_var
+    size_t value_size;
+    hash_fn_t hash_fn; // HASH_FN_DEFAULT; the top bits pick the shard, the low bits the slot inside it
+    uint64_t seed;
+
+    size_t num_of_shards; // always a power of two
+    uint32_t shard_bits;  // log2(num_of_shards)
+    conc_map_shard_t *shards;
+} conc_map_t;
+
+// map_t split into independent shards so it can be used from many threads at once
+// each key is hashed once; operations on keys in different shards run in parallel, searches in the same shard
+// share a read lock, and a shard that outgrows its slots resizes without touching the others
+// num_of_shards of 0 picks CONC_MAP_DEFAULT_SHARDS; it is rounded up to a power of two
+conc_map_t *conc_map_create(size_t key_size, size_t value_size, size_t num_of_shards);
+conc_map_t *conc_map_create_var(size_t value_size, size_t num_of_shards); // keys of any length
+void conc_map_destroy(conc_map_t *map); // must not race with any other call on the map
+
+bool conc_map_insert(conc_map_t *map, const void *key, const void *value); // overwrites the value of an existing key
+bool conc_map_remove(conc_map_t *map, const void *key);
+bool conc_map_search(conc_map_t *map, const void *key, void *value); // value may be NULL to only test membership
+
+// variable-length versions; on a fixed-size map key_len must equal key_size
+bool conc_map_insert_var(conc_map_t *map, const void *key, size_t key_len, const void *value);
+bool conc_map_remove_var(conc_map_t *map, const void *key, size_t key_len);
+bool conc_map_search_var(conc_map_t *map, const void *key, size_t key_len, void *value);
+
+size_t conc_map_size(conc_map_t *map); // a snapshot; may be stale by the time it returns
+
+// calls visit(key, key_len, value, ctx) on every entry until it returns false; returns false if it stopped early
+// shards are walked one at a time under their read lock, so each shard is seen in a consistent state while
+// writers keep going on the others; an entry added or removed in a shard not yet walked may or may not be seen
+// visit must not call back into the map
+typedef bool (*conc_map_visit_fn)(const void *key, size_t key_len, const void *value, void *ctx);
+bool conc_map_foreach(conc_map_t *map, conc_map_visit_fn visit, void *ctx);
+
+#endif
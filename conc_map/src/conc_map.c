@@ -0,0 +1,229 @@
+#include "../inc/conc_map.h"
+
+#include <string.h>
+
+static inline uint64_t conc_map_hash(const conc_map_t *map, const void *key, size_t key_len)
+{
+    return map->hash_fn(key, key_len, map->seed);
+}
+
+// the top bits pick the shard; the shard's map_t slots by the low bits, so the two never correlate
+static inline conc_map_shard_t *conc_map_shard(const conc_map_t *map, uint64_t hash)
+{
+    if (!map->shard_bits)
+        return &map->shards[0];
+    return &map->shards[hash >> (64 - map->shard_bits)];
+}
+
+static inline bool conc_map_key_len_ok(const conc_map_t *map, size_t key_len)
+{
+    return map->key_size ? key_len == map->key_size : key_len <= UINT32_MAX;
+}
+
+static conc_map_t *conc_map_create_sized(size_t key_size, size_t value_size, size_t num_of_shards)
+{
+    if (!value_size)
+        return NULL;
+
+    conc_map_t *map = malloc(sizeof(conc_map_t));
+    if (!map)
+        return NULL;
+
+    if (!num_of_shards)
+        num_of_shards = CONC_MAP_DEFAULT_SHARDS;
+
+    uint32_t shard_bits = 0;
+    while (((size_t)1 << shard_bits) < num_of_shards)
+        shard_bits++;
+    num_of_shards = (size_t)1 << shard_bits;
+
+    // shards are cache-line aligned so that neighbouring locks don't share a line
+    map->shards = aligned_alloc(CONC_MAP_CACHE_LINE, num_of_shards * sizeof(conc_map_shard_t));
+    if (!map->shards)
+    {
+        free(map);
+        return NULL;
+    }
+
+    for (size_t index = 0; index < num_of_shards; index++)
+    {
+        conc_map_shard_t *shard = &map->shards[index];
+
+        // a fresh map_t is small and allocates no slots, so idle shards cost next to nothing
+        shard->map = key_size ? map_create(key_size, value_size) : map_create_var(value_size);
+        if (!shard->map || pthread_rwlock_init(&shard->lock, NULL))
+        {
+            map_destroy(shard->map);
+            for (size_t counter = 0; counter < index; counter++)
+            {
+                map_destroy(map->shards[counter].map);
+                pthread_rwlock_destroy(&map->shards[counter].lock);
+            }
+            free(map->shards);
+            free(map);
+            return NULL;
+        }
+    }
+
+    map->key_size = key_size;
+    map->value_size = value_size;
+    map->hash_fn = HASH_FN_DEFAULT;
+    map->seed = HASH_DEFAULT_SEED;
+    map->num_of_shards = num_of_shards;
+    map->shard_bits = shard_bits;
+
+    return map;
+}
+
+conc_map_t *conc_map_create(size_t key_size, size_t value_size, size_t num_of_shards)
+{
+    if (!key_size)
+        return NULL;
+
+    return conc_map_create_sized(key_size, value_size, num_of_shards);
+}
+
+conc_map_t *conc_map_create_var(size_t value_size, size_t num_of_shards)
+{
+    return conc_map_create_sized(0, value_size, num_of_shards);
+}
+
+void conc_map_destroy(conc_map_t *map)
+{
+    if (!map)
+        return;
+
+    for (size_t index = 0; index < map->num_of_shards; index++)
+    {
+        map_destroy(map->shards[index].map);
+        pthread_rwlock_destroy(&map->shards[index].lock);
+    }
+
+    free(map->shards);
+    free(map);
+}
+
+bool conc_map_insert(conc_map_t *map, const void *key, const void *value)
+{
+    if (!map || !map->key_size)
+        return false;
+
+    return conc_map_insert_var(map, key, map->key_size, value);
+}
+
+bool conc_map_remove(conc_map_t *map, const void *key)
+{
+    if (!map || !map->key_size)
+        return false;
+
+    return conc_map_remove_var(map, key, map->key_size);
+}
+
+bool conc_map_search(conc_map_t *map, const void *key, void *value)
+{
+    if (!map || !map->key_size)
+        return false;
+
+    return conc_map_search_var(map, key, map->key_size, value);
+}
+
+// each key is hashed once, here, outside any lock; the shard's map_t reuses the hash for its own slot index
+bool conc_map_insert_var(conc_map_t *map, const void *key, size_t key_len, const void *value)
+{
+    if (!map || !key || !value || !conc_map_key_len_ok(map, key_len))
+        return false;
+
+    uint64_t hash = conc_map_hash(map, key, key_len);
+    conc_map_shard_t *shard = conc_map_shard(map, hash);
+
+    pthread_rwlock_wrlock(&shard->lock);
+    bool ok = map_insert_hashed(shard->map, key, key_len, value, hash);
+    pthread_rwlock_unlock(&shard->lock);
+
+    return ok;
+}
+
+bool conc_map_remove_var(conc_map_t *map, const void *key, size_t key_len)
+{
+    if (!map || !key || !conc_map_key_len_ok(map, key_len))
+        return false;
+
+    uint64_t hash = conc_map_hash(map, key, key_len);
+    conc_map_shard_t *shard = conc_map_shard(map, hash);
+
+    pthread_rwlock_wrlock(&shard->lock);
+    bool removed = map_remove_hashed(shard->map, key, key_len, hash);
+    pthread_rwlock_unlock(&shard->lock);
+
+    return removed;
+}
+
+bool conc_map_search_var(conc_map_t *map, const void *key, size_t key_len, void *value)
+{
+    if (!map || !key || !conc_map_key_len_ok(map, key_len))
+        return false;
+
+    uint64_t hash = conc_map_hash(map, key, key_len);
+    conc_map_shard_t *shard = conc_map_shard(map, hash);
+
+    // map_t lookups never write, so readers of one shard can run side by side
+    pthread_rwlock_rdlock(&shard->lock);
+    const void *stored = map_get_ptr_hashed(shard->map, key, key_len, hash);
+    if (stored && value)
+        memcpy(value, stored, map->value_size);
+    pthread_rwlock_unlock(&shard->lock);
+
+    return stored != NULL;
+}
+
+size_t conc_map_size(conc_map_t *map)
+{
+    if (!map)
+        return 0;
+
+    size_t total = 0;
+    for (size_t index = 0; index < map->num_of_shards; index++)
+    {
+        conc_map_shard_t *shard = &map->shards[index];
+
+        pthread_rwlock_rdlock(&shard->lock);
+        total += shard->map->num_of_entries;
+        pthread_rwlock_unlock(&shard->lock);
+    }
+
+    return total;
+}
+
+typedef struct
+{
+    conc_map_visit_fn visit;
+    void *ctx;
+} conc_map_visit_t;
+
+static bool conc_map_visit_entry(const void *key, size_t key_len, void *value, void *ctx)
+{
+    conc_map_visit_t *outer = (conc_map_visit_t *)ctx;
+    return outer->visit(key, key_len, value, outer->ctx);
+}
+
+bool conc_map_foreach(conc_map_t *map, conc_map_visit_fn visit, void *ctx)
+{
+    if (!map || !visit)
+        return false;
+
+    conc_map_visit_t outer = {visit, ctx};
+
+    for (size_t index = 0; index < map->num_of_shards; index++)
+    {
+        conc_map_shard_t *shard = &map->shards[index];
+
+        pthread_rwlock_rdlock(&shard->lock);
+        bool finished = map_foreach(shard->map, conc_map_visit_entry, &outer);
+        pthread_rwlock_unlock(&shard->lock);
+
+        if (!finished)
+            return false;
+    }
+
+    return true;
+}
@@ -16,6 +16,9 @@ typedef struct
     void **nodes;      // Array of node pointers
     void *default_value;
     bool is_empty;
+    bool lazy_default; // default_value is not all zero, so chunks are filled with it on first touch
+    size_t *marks;     // with lazy_default, per node: items below the mark hold real values, the rest read as the default
+
 } dyn_arr_t;
 
 // Function pointer type for comparing two items
@@ -25,6 +28,8 @@ typedef bool (*dyn_compare_t)(const void *a, const void *b);
  * Creates a new dynamic array
  * @param min_size Minimum capacity of the array
  * @param item_size Size of each item in bytes
+ * @param default_value Item that unwritten slots read as, or NULL to leave them uninitialized;
+ *                      an all-zero default costs nothing, any other is written into a chunk only as far as it is used
  * @return Pointer to the new dynamic array, or NULL if allocation failed
  */
 dyn_arr_t *dyn_arr_create(size_t min_size, size_t item_size, void *default_value);
@@ -61,8 +66,78 @@ bool dyn_arr_append(dyn_arr_t *dyn_arr, const void *item);
  */
 bool dyn_arr_get(dyn_arr_t *dyn_arr, size_t index, void *output);
 
+// dyn_arr_at's path for an item past its chunk's mark; writes the default into it first
+void *dyn_arr_at_slow(dyn_arr_t *dyn_arr, size_t index);
+
+/**
+ * Gets a pointer to the item at the specified index, without copying it
+ * Chunks never move once allocated, so the pointer stays valid until the array is freed
+ * An item that still reads as a lazy default gets the default written into it first, since the caller may write through the pointer
+ * @param dyn_arr Pointer to the dynamic array
+ * @param index Index of the item
+ * @return Pointer to the item inside the array, or NULL if no chunk backs the index
+ */
+static inline void *dyn_arr_at(dyn_arr_t *dyn_arr, size_t index)
+{
+    size_t node_no = index / MAX_NODE_SIZE;
+    size_t node_index = index & (MAX_NODE_SIZE - 1);
+    if (node_no >= dyn_arr->len || !dyn_arr->nodes[node_no])
+    {
+        return NULL;
+    }
+
+    if (dyn_arr->lazy_default && node_index >= dyn_arr->marks[node_no])
+    {
+        return dyn_arr_at_slow(dyn_arr, index);
+    }
+
+    return (char *)dyn_arr->nodes[node_no] + node_index * dyn_arr->item_size;
+}
+
+/**
+ * Gets the contiguous run of items that starts at index and stays inside one chunk
+ * Every item of the run holds a real value afterwards, lazy defaults included
+ * Walking a range is a loop of spans: for (i = start; i <= end; i += n) n = dyn_arr_span(dyn_arr, i, end, &span);
+ * @param dyn_arr Pointer to the dynamic array
+ * @param index Index of the first item of the run
+ * @param end_index Last index the caller wants (inclusive); the run never goes past it
+ * @param span Receives a pointer to the item at index
+ * @return Number of items in the run, or 0 if no chunk backs index or index > end_index
+ */
+size_t dyn_arr_span(dyn_arr_t *dyn_arr, size_t index, size_t end_index, void **span);
+
+/**
+ * Copies a range of items out of the array, one memcpy per chunk
+ * @param dyn_arr Pointer to the dynamic array
+ * @param start_index Starting index (inclusive)
+ * @param end_index Ending index (inclusive)
+ * @param output Memory for end_index - start_index + 1 packed items
+ * @return true if successful, false if the indices are invalid or part of the range has no chunk
+ */
+bool dyn_arr_copy_range(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, void *output);
+
+/**
+ * Appends count packed items after the last occupied index, one memcpy per chunk
+ * @param dyn_arr Pointer to the dynamic array
+ * @param items Pointer to count items to copy into the array
+ * @param count Number of items
+ * @return true if successful, false if allocation failed (the items before the failing chunk stay appended)
+ */
+bool dyn_arr_append_n(dyn_arr_t *dyn_arr, const void *items, size_t count);
+
+/**
+ * Sets every item in a range to a copy of item, allocating chunks as needed
+ * @param dyn_arr Pointer to the dynamic array
+ * @param start_index Starting index (inclusive)
+ * @param end_index Ending index (inclusive)
+ * @param item Pointer to the item to copy into the range
+ * @return true if successful, false if the indices are invalid or allocation failed
+ */
+bool dyn_arr_fill(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, const void *item);
+
 /**
  * Sorts items in the dynamic array
+ * Same as dyn_arr_sort_ex with no flags on one thread: an unstable introsort using one scratch buffer the size of the range
  * @param dyn_arr Pointer to the dynamic array
  * @param start_index Starting index (inclusive)
  * @param end_index Ending index (inclusive)
@@ -71,6 +146,43 @@ bool dyn_arr_get(dyn_arr_t *dyn_arr, size_t index, void *output);
  */
 bool dyn_arr_sort(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, dyn_compare_t compare);
 
+// flags for dyn_arr_sort_ex
+#define DYN_ARR_SORT_STABLE (1U << 0) // items that compare equal keep their order (merge sort instead of introsort)
+
+/**
+ * Sorts items in the dynamic array, optionally stable and on several threads
+ * The range is copied into one scratch allocation (twice its size when stable or threaded), sorted there, and copied back
+ * @param dyn_arr Pointer to the dynamic array
+ * @param start_index Starting index (inclusive)
+ * @param end_index Ending index (inclusive)
+ * @param compare Comparison function that returns true if a should come before b; it must be safe to call from several threads
+ * @param flags DYN_ARR_SORT_* flags
+ * @param num_of_threads Threads to sort with (0 means one per online core); short ranges use fewer
+ * @return true if successful, false if allocation failed or indices are invalid
+ */
+bool dyn_arr_sort_ex(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, dyn_compare_t compare,
+                     uint32_t flags, size_t num_of_threads);
+
+// key types for dyn_arr_sort_by_key; with neither flag the key is an unsigned integer
+#define DYN_ARR_SORT_KEY_SIGNED (1U << 1) // two's complement integer
+#define DYN_ARR_SORT_KEY_FLOAT (1U << 2)  // IEEE 754 float (4 bytes) or double (8 bytes)
+
+/**
+ * Sorts items in the dynamic array by a numeric key stored inside each item, in ascending key order
+ * A stable LSD radix sort: linear in the number of items, with no comparison callback; it needs one scratch
+ * buffer the size of the range, or two if more than one byte of the key differs between items
+ * Float keys order -0.0 before +0.0, and NaNs after +inf (or before -inf if their sign bit is set)
+ * @param dyn_arr Pointer to the dynamic array
+ * @param start_index Starting index (inclusive)
+ * @param end_index Ending index (inclusive)
+ * @param key_offset Byte offset of the key inside an item
+ * @param key_width Size of the key in bytes: 1, 2, 4 or 8 (4 or 8 for floats), in native byte order
+ * @param flags DYN_ARR_SORT_KEY_* flags (DYN_ARR_SORT_STABLE is accepted and changes nothing)
+ * @return true if successful, false if allocation failed or the indices or key are invalid
+ */
+bool dyn_arr_sort_by_key(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, size_t key_offset,
+                         size_t key_width, uint32_t flags);
+
 /**
  * Finds the maximum element in the range
  * @param dyn_arr Pointer to the dynamic array
@@ -93,4 +205,46 @@ bool dyn_arr_max(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, dyn_c
  */
 bool dyn_arr_min(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, dyn_compare_t is_less, void *output);
 
+// element types for the typed reductions; the array's item_size must be the type's size
+#define DYN_ARR_TYPE_I32 (0U) // int32_t
+#define DYN_ARR_TYPE_I64 (1U) // int64_t
+#define DYN_ARR_TYPE_U32 (2U) // uint32_t
+#define DYN_ARR_TYPE_U64 (3U) // uint64_t
+#define DYN_ARR_TYPE_F32 (4U) // float
+#define DYN_ARR_TYPE_F64 (5U) // double
+
+// comparisons for dyn_arr_reduce_count_if, as item <op> operand
+#define DYN_ARR_CMP_LT (0U)
+#define DYN_ARR_CMP_LE (1U)
+#define DYN_ARR_CMP_EQ (2U)
+#define DYN_ARR_CMP_NE (3U)
+#define DYN_ARR_CMP_GE (4U)
+#define DYN_ARR_CMP_GT (5U)
+
+/*
+ * Typed reductions over a range of numeric items
+ * They read the items where they sit, a chunk at a time, with AVX2 kernels when the CPU has them and plain loops
+ * otherwise; a lazy default is never written out. Chunks that were never allocated are skipped, but as with
+ * dyn_arr_min the range has to start in one that was.
+ * Floats follow C's comparisons: min/max/argmin/argmax skip NaNs (a range of nothing but NaNs gives its first item),
+ * and a NaN only counts for DYN_ARR_CMP_NE.
+ * All of them return false if the indices or type are invalid, or item_size does not match the type.
+ */
+
+// output is an item of the given type
+bool dyn_arr_reduce_min(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type, void *output);
+bool dyn_arr_reduce_max(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type, void *output);
+
+// index of the first item holding the minimum/maximum
+bool dyn_arr_reduce_argmin(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type, size_t *index);
+bool dyn_arr_reduce_argmax(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type, size_t *index);
+
+// output is an int64_t for signed types and a uint64_t for unsigned ones (both wrapping modulo 2^64), a double for
+// floats; float items are added in a different order than a plain loop would, so the last bits can differ
+bool dyn_arr_reduce_sum(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type, void *output);
+
+// counts the items for which item <cmp> *operand holds; operand is a value of the given type
+bool dyn_arr_reduce_count_if(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type,
+                             uint32_t cmp, const void *operand, size_t *count);
+
 #endif // DYN_ARR_H
\ No newline at end of file
@@ -1,5 +1,129 @@
 #include "../inc/dyn_arr.h"
+
 #include <math.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DYN_ARR_HAVE_X86_SIMD 1
+#endif
+
+#define SORT_INSERTION_CUTOFF (24U)  // ranges this short are insertion sorted
+#define SORT_PARALLEL_MIN (1U << 14) // items each sort thread should get before another one is worth starting
+#define SORT_ITEM_ALIGN (_Alignof(max_align_t))
+#define SORT_ALIGN_UP(x) (((x) + SORT_ITEM_ALIGN - 1) & ~(size_t)(SORT_ITEM_ALIGN - 1))
+#define SORT_TMP_STRIDE(item_size) SORT_ALIGN_UP(item_size) // a temporary item, padded so the next one stays aligned
+#define REDUCE_BLOCK (4096U)          // items per block when the typed reductions track where an extreme is
+
+// copies item into the first slot of dst and then doubles the filled prefix, so filling count items
+// takes log2(count) memcpy calls instead of count
+static void dyn_arr_fill_items(void *dst, const void *item, size_t count, size_t item_size)
+{
+    if (!count)
+    {
+        return;
+    }
+
+    memcpy(dst, item, item_size);
+
+    size_t filled = 1;
+    while (filled < count)
+    {
+        size_t batch = filled < count - filled ? filled : count - filled;
+        memcpy((char *)dst + filled * item_size, dst, batch * item_size);
+        filled += batch;
+    }
+}
+
+// returns chunk node_no, growing the node table and allocating the chunk if needed
+// a new chunk is never filled here: with an all-zero default calloc hands out zero pages, and any other
+// default is written lazily behind the chunk's mark (see dyn_arr_touch), so an allocated chunk only
+// commits the pages that are actually written
+static void *dyn_arr_chunk(dyn_arr_t *dyn_arr, size_t node_no)
+{
+    if (node_no >= dyn_arr->len)
+    {
+        size_t new_len = dyn_arr->len ? dyn_arr->len : 1;
+        while (new_len <= node_no)
+        {
+            new_len <<= 1U;
+        }
+
+        void **new_nodes = (void **)realloc(dyn_arr->nodes, new_len * sizeof(void *));
+        if (!new_nodes)
+        {
+            return NULL;
+        }
+
+        // set all the unallocated node ptrs to NULL
+        memset(new_nodes + dyn_arr->len, 0, (new_len - dyn_arr->len) * sizeof(void *));
+        dyn_arr->nodes = new_nodes;
+
+        if (dyn_arr->lazy_default)
+        {
+            size_t *new_marks = (size_t *)realloc(dyn_arr->marks, new_len * sizeof(size_t));
+            if (!new_marks)
+            {
+                return NULL; // the larger node table is kept; len only moves once both tables have grown
+            }
+
+            memset(new_marks + dyn_arr->len, 0, (new_len - dyn_arr->len) * sizeof(size_t));
+            dyn_arr->marks = new_marks;
+        }
+
+        dyn_arr->len = new_len;
+    }
+
+    if (!dyn_arr->nodes[node_no])
+    {
+        if (dyn_arr->default_value && !dyn_arr->lazy_default)
+        {
+            dyn_arr->nodes[node_no] = calloc(MAX_NODE_SIZE, dyn_arr->item_size);
+        }
+        else
+        {
+            dyn_arr->nodes[node_no] = malloc(MAX_NODE_SIZE * dyn_arr->item_size);
+        }
+
+        if (!dyn_arr->nodes[node_no])
+        {
+            return NULL;
+        }
+
+        if (dyn_arr->lazy_default)
+        {
+            dyn_arr->marks[node_no] = 0;
+        }
+    }
+
+    return dyn_arr->nodes[node_no];
+}
+
+// makes sure the first end items of an allocated chunk hold real values, writing the default into
+// the ones between the chunk's mark and end; a no-op unless the default is lazy
+static void dyn_arr_touch(dyn_arr_t *dyn_arr, size_t node_no, size_t end)
+{
+    if (!dyn_arr->lazy_default || dyn_arr->marks[node_no] >= end)
+    {
+        return;
+    }
+
+    size_t mark = dyn_arr->marks[node_no];
+    dyn_arr_fill_items((char *)dyn_arr->nodes[node_no] + mark * dyn_arr->item_size, dyn_arr->default_value,
+                       end - mark, dyn_arr->item_size);
+    dyn_arr->marks[node_no] = end;
+}
+
+void *dyn_arr_at_slow(dyn_arr_t *dyn_arr, size_t index)
+{
+    size_t node_no = index / MAX_NODE_SIZE;
+    size_t node_index = index & (MAX_NODE_SIZE - 1);
+
+    dyn_arr_touch(dyn_arr, node_no, node_index + 1);
+    return (char *)dyn_arr->nodes[node_no] + node_index * dyn_arr->item_size;
+}
 
 dyn_arr_t *dyn_arr_create(size_t min_size, size_t item_size, void *default_value)
 {
@@ -17,6 +141,10 @@ dyn_arr_t *dyn_arr_create(size_t min_size, size_t item_size, void *default_value
     dyn_arr->item_size = item_size;
     dyn_arr->last_index = 0;
     dyn_arr->is_empty = true;
+    dyn_arr->len = 0;
+    dyn_arr->nodes = NULL;
+    dyn_arr->marks = NULL;
+    dyn_arr->lazy_default = false;
 
     if (!default_value)
     {
@@ -31,63 +159,34 @@ dyn_arr_t *dyn_arr_create(size_t min_size, size_t item_size, void *default_value
             return NULL;
         }
 
-        if (!memcpy(dyn_arr->default_value, default_value, item_size))
+        memcpy(dyn_arr->default_value, default_value, item_size);
+
+        // an all-zero default comes for free from calloc; anything else is written on first touch
+        for (size_t index = 0; index < item_size; index++)
         {
-            free(dyn_arr->default_value);
-            free(dyn_arr);
-            return NULL;
+            if (((const unsigned char *)default_value)[index])
+            {
+                dyn_arr->lazy_default = true;
+                break;
+            }
         }
     }
 
     if (!min_size)
     {
-        dyn_arr->len = 0;
-        dyn_arr->nodes = NULL;
         return dyn_arr;
     }
 
     size_t num_of_nodes = min_size / MAX_NODE_SIZE + 1;
-    void **nodes = (void **)calloc(num_of_nodes, sizeof(void *));
-    if (!nodes)
-    {
-        free(dyn_arr);
-        return NULL;
-    }
-
     for (size_t index = 0; index < num_of_nodes; index++)
     {
-        nodes[index] = malloc(MAX_NODE_SIZE * item_size);
-        if (!nodes[index])
-        {
-            for (size_t counter = 0; counter < index; counter++)
-            {
-                free(nodes[counter]);
-                free(nodes);
-                free(dyn_arr);
-                return NULL;
-            }
-        }
-
-        if (default_value)
+        if (!dyn_arr_chunk(dyn_arr, index))
         {
-            for (size_t counter = 0; counter < MAX_NODE_SIZE; counter++)
-            {
-                if (!memcpy((char *)nodes[index] + (counter * item_size), default_value, item_size))
-                {
-                    for (size_t count = 0; count <= index; count++)
-                    {
-                        free(nodes[count]);
-                    }
-                    free(nodes);
-                    free(dyn_arr);
-                    return NULL;
-                }
-            }
+            dyn_arr_free(dyn_arr);
+            return NULL;
         }
     }
 
-    dyn_arr->len = num_of_nodes;
-    dyn_arr->nodes = nodes;
     return dyn_arr;
 }
 
@@ -104,6 +203,7 @@ void dyn_arr_free(dyn_arr_t *dyn_arr)
     }
 
     free(dyn_arr->default_value);
+    free(dyn_arr->marks);
     free(dyn_arr->nodes);
     free(dyn_arr);
 }
@@ -123,41 +223,14 @@ bool dyn_arr_set(dyn_arr_t *dyn_arr, size_t index, const void *item)
     size_t node_index = index & (MAX_NODE_SIZE - 1);
     size_t node_no = index / MAX_NODE_SIZE;
 
-    if (node_no >= dyn_arr->len)
-    {
-        size_t new_len = 1U << ((size_t)log2(node_no) + 1U);
-        void **new_nodes = (void **)realloc(dyn_arr->nodes, new_len * sizeof(void *));
-        if (!new_nodes)
-        {
-            return false;
-        }
-
-        // set all the unallocated node ptrs to NULL
-        memset(new_nodes + dyn_arr->len, 0, (new_len - dyn_arr->len) * sizeof(void *));
-        dyn_arr->nodes = new_nodes;
-        dyn_arr->len = new_len;
-    }
-
-    if (!dyn_arr->nodes[node_no])
+    void *node = dyn_arr_chunk(dyn_arr, node_no);
+    if (!node)
     {
-        dyn_arr->nodes[node_no] = malloc(MAX_NODE_SIZE * dyn_arr->item_size);
-        if (!dyn_arr->nodes[node_no])
-        {
-            return false;
-        }
-
-        if (dyn_arr->default_value)
-        {
-            for (size_t counter = 0; counter < MAX_NODE_SIZE; counter++)
-            {
-                memcpy((char *)dyn_arr->nodes[node_no] + (counter * dyn_arr->item_size),
-                       dyn_arr->default_value, dyn_arr->item_size);
-            }
-        }
+        return false;
     }
 
-    memcpy((char *)dyn_arr->nodes[node_no] + (node_index * dyn_arr->item_size),
-           item, dyn_arr->item_size);
+    dyn_arr_touch(dyn_arr, node_no, node_index + 1);
+    memcpy((char *)node + (node_index * dyn_arr->item_size), item, dyn_arr->item_size);
 
     if (dyn_arr->is_empty)
     {
@@ -181,203 +254,1610 @@ bool dyn_arr_get(dyn_arr_t *dyn_arr, size_t index, void *output)
         return false;
     }
 
+    // past the mark nothing has been written, so the item still reads as the default
+    if (dyn_arr->lazy_default && node_index >= dyn_arr->marks[node_no])
+    {
+        memcpy(output, dyn_arr->default_value, dyn_arr->item_size);
+        return true;
+    }
+
     memcpy(output, (char *)dyn_arr->nodes[node_no] + (node_index * dyn_arr->item_size),
            dyn_arr->item_size);
     return true;
 }
 
-bool dyn_arr_max(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index,
-                 dyn_compare_t is_less, void *output)
+// length of the run from index to the end of its chunk, capped at end_index
+static size_t dyn_arr_run(size_t index, size_t end_index)
 {
-    if (!dyn_arr || !output || start_index > end_index)
-    {
-        return false;
-    }
+    size_t count = MAX_NODE_SIZE - (index & (MAX_NODE_SIZE - 1));
+    return count > end_index - index + 1 ? end_index - index + 1 : count;
+}
 
-    char buffer[2 * dyn_arr->item_size];
-    void *max = buffer;
-    void *temp = buffer + dyn_arr->item_size;
+// read-only counterpart of dyn_arr_span that never writes a lazy default: the run is cut at the chunk's
+// mark, and a run past the mark comes back as the default value with a stride of 0
+// returns the run's length, or 0 if no chunk backs index
+static size_t dyn_arr_peek(const dyn_arr_t *dyn_arr, size_t index, size_t end_index, const char **span, size_t *stride)
+{
+    size_t node_no = index / MAX_NODE_SIZE;
+    size_t node_index = index & (MAX_NODE_SIZE - 1);
 
-    if (!dyn_arr_get(dyn_arr, start_index, max))
+    if (node_no >= dyn_arr->len || !dyn_arr->nodes[node_no])
     {
-        return false;
+        return 0;
     }
 
-    for (size_t i = start_index + 1; i <= end_index; i++)
+    size_t count = dyn_arr_run(index, end_index);
+
+    if (dyn_arr->lazy_default)
     {
-        if (!dyn_arr_get(dyn_arr, i, temp))
+        size_t mark = dyn_arr->marks[node_no];
+        if (node_index >= mark)
         {
-            continue;
+            *span = (const char *)dyn_arr->default_value;
+            *stride = 0;
+            return count;
         }
 
-        if (is_less(max, temp))
+        if (count > mark - node_index)
         {
-            void *swap = max;
-            max = temp;
-            temp = swap;
+            count = mark - node_index;
         }
     }
 
-    memcpy(output, max, dyn_arr->item_size);
-    return true;
+    *span = (const char *)dyn_arr->nodes[node_no] + node_index * dyn_arr->item_size;
+    *stride = dyn_arr->item_size;
+    return count;
 }
 
-bool dyn_arr_min(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index,
-                 dyn_compare_t is_less, void *output)
+size_t dyn_arr_span(dyn_arr_t *dyn_arr, size_t index, size_t end_index, void **span)
 {
-    if (!dyn_arr || !output || start_index > end_index)
+    if (!dyn_arr || !span || index > end_index)
     {
-        return false;
+        return 0;
+    }
+
+    void *item = dyn_arr_at(dyn_arr, index);
+    if (!item)
+    {
+        return 0;
     }
 
-    char buffer[2 * dyn_arr->item_size];
-    void *min = buffer;
-    void *temp = buffer + dyn_arr->item_size;
+    // the caller may write anywhere in the run, so all of it has to hold real values
+    size_t count = dyn_arr_run(index, end_index);
+    dyn_arr_touch(dyn_arr, index / MAX_NODE_SIZE, (index & (MAX_NODE_SIZE - 1)) + count);
 
-    if (!dyn_arr_get(dyn_arr, start_index, min))
+    *span = item;
+    return count;
+}
+
+bool dyn_arr_copy_range(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, void *output)
+{
+    if (!dyn_arr || !output || start_index > end_index)
     {
         return false;
     }
 
-    for (size_t i = start_index + 1; i <= end_index; i++)
+    char *dst = (char *)output;
+    for (size_t index = start_index; index <= end_index;)
     {
-        if (!dyn_arr_get(dyn_arr, i, temp))
+        const char *span;
+        size_t stride;
+        size_t count = dyn_arr_peek(dyn_arr, index, end_index, &span, &stride);
+        if (!count)
         {
-            continue;
+            return false;
+        }
+
+        if (stride)
+        {
+            memcpy(dst, span, count * dyn_arr->item_size);
+        }
+        else
+        {
+            dyn_arr_fill_items(dst, span, count, dyn_arr->item_size);
         }
+        dst += count * dyn_arr->item_size;
 
-        if (is_less(temp, min))
+        if (end_index - index < count)
         {
-            void *swap = min;
-            min = temp;
-            temp = swap;
+            break; // the range ends in this run; stepping past it could overflow index
         }
+        index += count;
     }
 
-    memcpy(output, min, dyn_arr->item_size);
     return true;
 }
 
-bool dyn_arr_sort(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, dyn_compare_t compare)
+// writes count items starting at index chunk by chunk; items is either count packed items or,
+// with repeat set, one item written count times
+static bool dyn_arr_write_range(dyn_arr_t *dyn_arr, size_t index, const void *items, size_t count, bool repeat)
 {
-    if (!dyn_arr || start_index > end_index)
+    size_t item_size = dyn_arr->item_size;
+    const char *src = (const char *)items;
+    size_t written = 0;
+
+    while (written < count)
     {
-        return false;
+        size_t node_no = (index + written) / MAX_NODE_SIZE;
+        size_t node_index = (index + written) & (MAX_NODE_SIZE - 1);
+        char *node = (char *)dyn_arr_chunk(dyn_arr, node_no);
+        if (!node)
+        {
+            break;
+        }
+
+        size_t batch = MAX_NODE_SIZE - node_index;
+        if (batch > count - written)
+        {
+            batch = count - written;
+        }
+
+        // only the gap between the mark and the run gets the default; the run itself is overwritten
+        dyn_arr_touch(dyn_arr, node_no, node_index);
+
+        if (repeat)
+        {
+            dyn_arr_fill_items(node + node_index * item_size, items, batch, item_size);
+        }
+        else
+        {
+            memcpy(node + node_index * item_size, src + written * item_size, batch * item_size);
+        }
+        written += batch;
+
+        if (dyn_arr->lazy_default && dyn_arr->marks[node_no] < node_index + batch)
+        {
+            dyn_arr->marks[node_no] = node_index + batch;
+        }
     }
 
-    if (start_index == end_index)
+    // whatever made it in counts as set, as with dyn_arr_set
+    if (written)
     {
-        return true;
+        if (dyn_arr->is_empty || index + written - 1 > dyn_arr->last_index)
+        {
+            dyn_arr->last_index = index + written - 1;
+        }
+        dyn_arr->is_empty = false;
     }
 
-    size_t mid = start_index + (end_index - start_index) / 2;
+    return written == count;
+}
 
-    if (!dyn_arr_sort(dyn_arr, start_index, mid, compare) ||
-        !dyn_arr_sort(dyn_arr, mid + 1, end_index, compare))
+bool dyn_arr_append_n(dyn_arr_t *dyn_arr, const void *items, size_t count)
+{
+    if (!dyn_arr || !items)
     {
         return false;
     }
 
-    size_t left_len = mid - start_index + 1;
-    size_t right_len = end_index - mid;
-    size_t item_size = dyn_arr->item_size;
+    return dyn_arr_write_range(dyn_arr, dyn_arr->is_empty ? 0 : dyn_arr->last_index + 1, items, count, false);
+}
 
-    void *temp_buffer = malloc((left_len + right_len + 2) * item_size);
-    if (!temp_buffer)
+bool dyn_arr_fill(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, const void *item)
+{
+    if (!dyn_arr || !item || start_index > end_index)
     {
         return false;
     }
 
-    void *left_temp = temp_buffer;
-    void *right_temp = (char *)temp_buffer + (left_len * item_size);
-    void *left_item = (char *)right_temp + (right_len * item_size);
-    void *right_item = (char *)left_item + item_size;
-
-    for (size_t i = 0; i < left_len; i++)
-    {
-        if (!dyn_arr_get(dyn_arr, start_index + i, (char *)left_temp + (i * item_size)))
-        {
-            free(temp_buffer);
-            return false;
-        }
-    }
+    return dyn_arr_write_range(dyn_arr, start_index, item, end_index - start_index + 1, true);
+}
 
-    for (size_t i = 0; i < right_len; i++)
+// the scan compares items where they sit, one run at a time, and never writes a lazy default: a run past
+// a chunk's mark is all default, so it takes a single compare; items in chunks that were never allocated
+// are skipped, as dyn_arr_get fails on them
+static bool dyn_arr_extreme(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index,
+                            dyn_compare_t is_less, bool want_max, void *output)
+{
+    if (!dyn_arr || !output || start_index > end_index)
     {
-        if (!dyn_arr_get(dyn_arr, mid + 1 + i, (char *)right_temp + (i * item_size)))
-        {
-            free(temp_buffer);
-            return false;
-        }
+        return false;
     }
 
-    size_t left_index = 0;
-    size_t right_index = 0;
-    size_t main_index = start_index;
+    const char *best = NULL;
 
-    while (left_index < left_len && right_index < right_len)
+    for (size_t i = start_index; i <= end_index;)
     {
-        memcpy(left_item, (char *)left_temp + (left_index * item_size), item_size);
-        memcpy(right_item, (char *)right_temp + (right_index * item_size), item_size);
-
-        if (compare(left_item, right_item))
+        const char *span;
+        size_t stride;
+        size_t count = dyn_arr_peek(dyn_arr, i, end_index, &span, &stride);
+        if (!count)
         {
-            if (!dyn_arr_set(dyn_arr, main_index++, left_item))
+            if (!best)
             {
-                free(temp_buffer);
-                return false;
+                return false; // as with dyn_arr_get, the first item has to exist
+            }
+
+            if ((i | (MAX_NODE_SIZE - 1)) >= end_index)
+            {
+                break;
             }
-            left_index++;
+            i = (i | (MAX_NODE_SIZE - 1)) + 1;
+            continue;
         }
-        else
+
+        size_t visits = stride ? count : 1;
+        for (size_t counter = 0; counter < visits; counter++)
         {
-            if (!dyn_arr_set(dyn_arr, main_index++, right_item))
+            const char *item = span + counter * stride;
+            if (!best || (want_max ? is_less(best, item) : is_less(item, best)))
             {
-                free(temp_buffer);
-                return false;
+                best = item;
             }
-            right_index++;
         }
+
+        if (end_index - i < count)
+        {
+            break; // the range ends in this run; stepping past it could overflow i
+        }
+        i += count;
     }
 
-    while (left_index < left_len)
+    memcpy(output, best, dyn_arr->item_size);
+    return true;
+}
+
+bool dyn_arr_max(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index,
+                 dyn_compare_t is_less, void *output)
+{
+    return dyn_arr_extreme(dyn_arr, start_index, end_index, is_less, true, output);
+}
+
+bool dyn_arr_min(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index,
+                 dyn_compare_t is_less, void *output)
+{
+    return dyn_arr_extreme(dyn_arr, start_index, end_index, is_less, false, output);
+}
+
+// the sort copies the range into one scratch allocation (a memcpy per chunk), sorts it there, and copies it back
+// ranges of up to SORT_INSERTION_CUTOFF items are insertion sorted; longer ones are introsorted in place, or
+// merge sorted for DYN_ARR_SORT_STABLE; with several threads each sorts one slice and the slices are then merged
+// pairwise, the pairs of each round in parallel
+
+// the sort helpers take their item-sized temporaries from tmp, carved out of the scratch allocation, so nothing
+// on the stack grows with item_size
+
+static void sort_insertion(char *base, size_t len, size_t item_size, dyn_compare_t compare, char *item)
+{
+    for (size_t i = 1; i < len; i++)
     {
-        memcpy(left_item, (char *)left_temp + (left_index * item_size), item_size);
-        if (!dyn_arr_set(dyn_arr, main_index++, left_item))
+        if (!compare(base + i * item_size, base + (i - 1) * item_size))
         {
-            free(temp_buffer);
-            return false;
+            continue;
         }
-        left_index++;
+
+        // only items that strictly come after it are moved past, so equal items keep their order
+        memcpy(item, base + i * item_size, item_size);
+        size_t j = i;
+        do
+        {
+            memcpy(base + j * item_size, base + (j - 1) * item_size, item_size);
+            j--;
+        } while (j && compare(item, base + (j - 1) * item_size));
+        memcpy(base + j * item_size, item, item_size);
     }
+}
 
-    while (right_index < right_len)
+static inline void sort_swap(char *a, char *b, char *tmp, size_t item_size)
+{
+    memcpy(tmp, a, item_size);
+    memcpy(a, b, item_size);
+    memcpy(b, tmp, item_size);
+}
+
+static void sort_sift_down(char *base, size_t root, size_t len, char *tmp, size_t item_size, dyn_compare_t compare)
+{
+    for (size_t child = 2 * root + 1; child < len; child = 2 * root + 1)
     {
-        memcpy(right_item, (char *)right_temp + (right_index * item_size), item_size);
-        if (!dyn_arr_set(dyn_arr, main_index++, right_item))
+        if (child + 1 < len && compare(base + child * item_size, base + (child + 1) * item_size))
         {
-            free(temp_buffer);
-            return false;
+            child++;
+        }
+        if (!compare(base + root * item_size, base + child * item_size))
+        {
+            return;
         }
-        right_index++;
-    }
 
-    free(temp_buffer);
-    return true;
+        sort_swap(base + root * item_size, base + child * item_size, tmp, item_size);
+        root = child;
+    }
 }
 
-bool dyn_arr_append(dyn_arr_t *dyn_arr, const void *item)
+// introsort's fallback once partitioning keeps going badly, so the worst case stays n log n
+static void sort_heap(char *base, size_t len, size_t item_size, dyn_compare_t compare, char *tmp)
 {
-    if (!dyn_arr || !item)
+    for (size_t root = len / 2; root--;)
     {
-        return false;
+        sort_sift_down(base, root, len, tmp, item_size, compare);
     }
 
-    if (dyn_arr->is_empty)
+    for (size_t end = len - 1; end; end--)
     {
-        dyn_arr->is_empty = false;
-        return dyn_arr_set(dyn_arr, 0, item);
+        sort_swap(base, base + end * item_size, tmp, item_size);
+        sort_sift_down(base, 0, end, tmp, item_size, compare);
     }
+}
 
-    return dyn_arr_set(dyn_arr, dyn_arr->last_index + 1, item);
-}
\ No newline at end of file
+// tmp holds two items: the pivot and room for a swap
+static void sort_intro(char *base, size_t len, size_t item_size, dyn_compare_t compare, size_t depth, char *tmp)
+{
+    char *pivot = tmp;
+    char *swap_tmp = tmp + SORT_TMP_STRIDE(item_size);
+
+    while (len > SORT_INSERTION_CUTOFF)
+    {
+        if (!depth--)
+        {
+            sort_heap(base, len, item_size, compare, swap_tmp);
+            return;
+        }
+
+        // median of three, left in the middle slot; the first and last items then bound both scans
+        char *first = base;
+        char *mid = base + (len / 2) * item_size;
+        char *last = base + (len - 1) * item_size;
+        if (compare(mid, first))
+            sort_swap(mid, first, swap_tmp, item_size);
+        if (compare(last, mid))
+        {
+            sort_swap(last, mid, swap_tmp, item_size);
+            if (compare(mid, first))
+                sort_swap(mid, first, swap_tmp, item_size);
+        }
+        memcpy(pivot, mid, item_size);
+
+        // hoare partition: [0, split) comes no later than the pivot, [split, len) no earlier
+        size_t i = 0;
+        size_t j = len - 1;
+        for (;;)
+        {
+            while (i < len - 1 && compare(base + i * item_size, pivot))
+                i++;
+            while (j && compare(pivot, base + j * item_size))
+                j--;
+            if (i >= j)
+                break;
+
+            sort_swap(base + i * item_size, base + j * item_size, swap_tmp, item_size);
+            i++;
+            j--;
+        }
+
+        size_t split = j + 1;
+        if (split >= len)
+            split = len - 1; // a comparator that is not strict can push j to the end; keep both sides non-empty
+
+        // recurse into the smaller side and loop on the larger, so the stack stays logarithmic
+        if (split < len - split)
+        {
+            sort_intro(base, split, item_size, compare, depth, tmp);
+            base += split * item_size;
+            len -= split;
+        }
+        else
+        {
+            sort_intro(base + split * item_size, len - split, item_size, compare, depth, tmp);
+            len = split;
+        }
+    }
+
+    sort_insertion(base, len, item_size, compare, swap_tmp);
+}
+
+// stable merge of two sorted runs into out; on a tie the left item goes first
+static void sort_merge(const char *left, size_t left_len, const char *right, size_t right_len, char *out,
+                       size_t item_size, dyn_compare_t compare)
+{
+    // runs that are already in order (common for presorted input) are just copied
+    if (!left_len || !right_len || !compare(right, left + (left_len - 1) * item_size))
+    {
+        memcpy(out, left, left_len * item_size);
+        memcpy(out + left_len * item_size, right, right_len * item_size);
+        return;
+    }
+
+    const char *left_end = left + left_len * item_size;
+    const char *right_end = right + right_len * item_size;
+
+    while (left < left_end && right < right_end)
+    {
+        if (compare(right, left))
+        {
+            memcpy(out, right, item_size);
+            right += item_size;
+        }
+        else
+        {
+            memcpy(out, left, item_size);
+            left += item_size;
+        }
+        out += item_size;
+    }
+
+    memcpy(out, left, (size_t)(left_end - left));
+    out += left_end - left;
+    memcpy(out, right, (size_t)(right_end - right));
+}
+
+// bottom-up merge sort over insertion-sorted runs, bouncing between items and aux; the result ends up in items
+static void sort_stable(char *items, char *aux, size_t len, size_t item_size, dyn_compare_t compare, char *tmp)
+{
+    for (size_t lo = 0; lo < len; lo += SORT_INSERTION_CUTOFF)
+    {
+        sort_insertion(items + lo * item_size, len - lo < SORT_INSERTION_CUTOFF ? len - lo : SORT_INSERTION_CUTOFF,
+                       item_size, compare, tmp);
+    }
+
+    char *src = items;
+    char *dst = aux;
+    for (size_t width = SORT_INSERTION_CUTOFF; width < len; width *= 2)
+    {
+        for (size_t lo = 0; lo < len; lo += 2 * width)
+        {
+            size_t mid = len - lo < width ? len : lo + width;
+            size_t hi = len - lo < 2 * width ? len : lo + 2 * width;
+            sort_merge(src + lo * item_size, mid - lo, src + mid * item_size, hi - mid, dst + lo * item_size, item_size, compare);
+        }
+
+        char *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != items)
+    {
+        memcpy(items, src, len * item_size);
+    }
+}
+
+typedef struct
+{
+    char *items;      // sort: the slice to sort in place; merge: the left run, with the right run right after it
+    char *aux;        // sort: scratch for the slice (stable only); merge: where the merged runs go
+    size_t len;       // sort: items in the slice; merge: items in the left run
+    size_t right_len; // merge only
+    size_t item_size;
+    dyn_compare_t compare;
+    bool stable;
+    char *tmp; // sort only: room for two items
+} sort_task_t;
+
+static void *sort_slice_worker(void *arg)
+{
+    sort_task_t *task = (sort_task_t *)arg;
+
+    if (task->stable)
+    {
+        sort_stable(task->items, task->aux, task->len, task->item_size, task->compare, task->tmp);
+    }
+    else
+    {
+        // 2 * log2(len) levels of bad partitions before falling back to heapsort
+        size_t depth = 0;
+        for (size_t len = task->len; len > 1; len >>= 1)
+        {
+            depth += 2;
+        }
+        sort_intro(task->items, task->len, task->item_size, task->compare, depth, task->tmp);
+    }
+
+    return NULL;
+}
+
+static void *sort_merge_worker(void *arg)
+{
+    sort_task_t *task = (sort_task_t *)arg;
+    sort_merge(task->items, task->len, task->items + task->len * task->item_size, task->right_len, task->aux,
+               task->item_size, task->compare);
+    return NULL;
+}
+
+// runs fn on every task, one thread each; the calling thread takes task 0, and also any task whose thread
+// could not be started (or all of them if there is no memory for the handles), so the sort never fails for
+// want of threads
+static void sort_run_tasks(sort_task_t *tasks, size_t count, void *(*fn)(void *))
+{
+    pthread_t *threads = (pthread_t *)malloc(count * sizeof(pthread_t));
+    bool *started = (bool *)calloc(count, sizeof(bool));
+
+    for (size_t index = 1; threads && started && index < count; index++)
+    {
+        started[index] = !pthread_create(&threads[index], NULL, fn, &tasks[index]);
+    }
+
+    fn(&tasks[0]);
+
+    for (size_t index = 1; index < count; index++)
+    {
+        if (!started || !started[index])
+        {
+            fn(&tasks[index]);
+        }
+    }
+
+    for (size_t index = 1; started && index < count; index++)
+    {
+        if (started[index])
+        {
+            pthread_join(threads[index], NULL);
+        }
+    }
+
+    free(threads);
+    free(started);
+}
+
+bool dyn_arr_sort(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, dyn_compare_t compare)
+{
+    return dyn_arr_sort_ex(dyn_arr, start_index, end_index, compare, 0, 1);
+}
+
+bool dyn_arr_sort_ex(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, dyn_compare_t compare,
+                     uint32_t flags, size_t num_of_threads)
+{
+    if (!dyn_arr || !compare || start_index > end_index)
+    {
+        return false;
+    }
+
+    if (start_index == end_index)
+    {
+        return true;
+    }
+
+    size_t len = end_index - start_index + 1;
+    size_t item_size = dyn_arr->item_size;
+    bool stable = flags & DYN_ARR_SORT_STABLE;
+
+    if (!num_of_threads)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        num_of_threads = cores > 0 ? (size_t)cores : 1;
+    }
+    if (num_of_threads > len / SORT_PARALLEL_MIN)
+    {
+        num_of_threads = len / SORT_PARALLEL_MIN ? len / SORT_PARALLEL_MIN : 1;
+    }
+
+    // the merge sort and the merge rounds need a second buffer; a lone introsort works in place
+    size_t buffers = stable || num_of_threads > 1 ? 2 : 1;
+    if (len > SIZE_MAX / item_size / buffers || item_size > SIZE_MAX / 4 - SORT_ITEM_ALIGN)
+    {
+        return false;
+    }
+
+    // one allocation, laid out as: the tasks, the slice bounds, two temporary items per thread, then the items
+    // (and aux); the temporaries and items start on max_align_t boundaries since compare reads them in place
+    size_t tmp_size = 2 * SORT_TMP_STRIDE(item_size);
+    size_t header = SORT_ALIGN_UP(num_of_threads * sizeof(sort_task_t) + (num_of_threads + 1) * sizeof(size_t));
+    size_t items_size = buffers * len * item_size;
+    if (num_of_threads > (SIZE_MAX - items_size) / (tmp_size + sizeof(sort_task_t) + 2 * sizeof(size_t)))
+    {
+        return false;
+    }
+
+    char *scratch = (char *)malloc(header + num_of_threads * tmp_size + items_size);
+    if (!scratch)
+    {
+        return false;
+    }
+
+    sort_task_t *tasks = (sort_task_t *)scratch;
+    size_t *bounds = (size_t *)(scratch + num_of_threads * sizeof(sort_task_t));
+    char *tmp = scratch + header;
+    char *items = tmp + num_of_threads * tmp_size;
+    char *aux = buffers == 2 ? items + len * item_size : NULL;
+
+    if (!dyn_arr_copy_range(dyn_arr, start_index, end_index, items))
+    {
+        free(scratch);
+        return false;
+    }
+
+    for (size_t index = 0; index <= num_of_threads; index++)
+    {
+        bounds[index] = len / num_of_threads * index + (len % num_of_threads) * index / num_of_threads;
+    }
+
+    for (size_t index = 0; index < num_of_threads; index++)
+    {
+        tasks[index] = (sort_task_t){
+            .items = items + bounds[index] * item_size,
+            .aux = aux ? aux + bounds[index] * item_size : NULL,
+            .len = bounds[index + 1] - bounds[index],
+            .item_size = item_size,
+            .compare = compare,
+            .stable = stable,
+            .tmp = tmp + index * tmp_size,
+        };
+    }
+
+    sort_run_tasks(tasks, num_of_threads, sort_slice_worker);
+
+    // merge rounds: run 2k and run 2k + 1 become one run in the other buffer; an odd run out is merged with nothing
+    char *src = items;
+    char *dst = aux;
+    for (size_t runs = num_of_threads; runs > 1; runs = (runs + 1) / 2)
+    {
+        size_t pairs = (runs + 1) / 2;
+        for (size_t pair = 0; pair < pairs; pair++)
+        {
+            size_t lo = bounds[2 * pair];
+            size_t mid = bounds[2 * pair + 1];
+            size_t hi = 2 * pair + 2 <= runs ? bounds[2 * pair + 2] : mid;
+
+            tasks[pair] = (sort_task_t){
+                .items = src + lo * item_size,
+                .aux = dst + lo * item_size,
+                .len = mid - lo,
+                .right_len = hi - mid,
+                .item_size = item_size,
+                .compare = compare,
+            };
+        }
+
+        sort_run_tasks(tasks, pairs, sort_merge_worker);
+
+        for (size_t pair = 0; pair <= pairs; pair++)
+        {
+            bounds[pair] = bounds[2 * pair < runs ? 2 * pair : runs];
+        }
+
+        char *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    bool ok = dyn_arr_write_range(dyn_arr, start_index, src, len, false);
+    free(scratch);
+    return ok;
+}
+
+// dyn_arr_sort_by_key is an LSD radix sort, one byte of the key per pass, least significant first; each pass is
+// stable, so after the last one the items are in key order and equal keys keep their order
+// keys are mapped to unsigned integers that order the same way: a signed key gets its sign bit flipped, a float
+// key gets its sign bit set if positive and every bit flipped if negative
+// all the digit histograms come from a single read of the range, and a pass whose digit is the same for every
+// item is skipped; the first pass reads straight out of the chunks, later ones bounce between two scratch buffers
+
+typedef struct
+{
+    size_t offset;
+    size_t width;
+    uint64_t sign;     // the key's top bit
+    uint64_t neg_flip; // xor-ed into keys with the top bit set
+    uint64_t pos_flip; // xor-ed into the rest
+} radix_key_t;
+
+static inline uint64_t radix_key(const radix_key_t *key, const char *item)
+{
+    uint64_t value;
+
+    switch (key->width)
+    {
+    case 1:
+    {
+        uint8_t raw;
+        memcpy(&raw, item + key->offset, sizeof(raw));
+        value = raw;
+        break;
+    }
+    case 2:
+    {
+        uint16_t raw;
+        memcpy(&raw, item + key->offset, sizeof(raw));
+        value = raw;
+        break;
+    }
+    case 4:
+    {
+        uint32_t raw;
+        memcpy(&raw, item + key->offset, sizeof(raw));
+        value = raw;
+        break;
+    }
+    default:
+        memcpy(&value, item + key->offset, sizeof(value));
+        break;
+    }
+
+    return value ^ (value & key->sign ? key->neg_flip : key->pos_flip);
+}
+
+// the common item sizes get a fixed-size copy the compiler can inline
+static inline void radix_copy(char *dst, const char *src, size_t item_size)
+{
+    switch (item_size)
+    {
+    case 4:
+        memcpy(dst, src, 4);
+        break;
+    case 8:
+        memcpy(dst, src, 8);
+        break;
+    case 16:
+        memcpy(dst, src, 16);
+        break;
+    default:
+        memcpy(dst, src, item_size);
+        break;
+    }
+}
+
+// moves count items to their bucket for the byte at shift; a stride of 0 means count copies of one item
+static void radix_scatter(const char *src, size_t count, size_t stride, char *dst, size_t *offsets,
+                          unsigned shift, const radix_key_t *key, size_t item_size)
+{
+    if (!stride)
+    {
+        size_t *offset = &offsets[(radix_key(key, src) >> shift) & 0xFF];
+        dyn_arr_fill_items(dst + *offset * item_size, src, count, item_size);
+        *offset += count;
+        return;
+    }
+
+    for (size_t index = 0; index < count; index++, src += stride)
+    {
+        size_t *offset = &offsets[(radix_key(key, src) >> shift) & 0xFF];
+        radix_copy(dst + *offset * item_size, src, item_size);
+        (*offset)++;
+    }
+}
+
+bool dyn_arr_sort_by_key(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, size_t key_offset,
+                         size_t key_width, uint32_t flags)
+{
+    if (!dyn_arr || start_index > end_index)
+    {
+        return false;
+    }
+
+    bool is_signed = flags & DYN_ARR_SORT_KEY_SIGNED;
+    bool is_float = flags & DYN_ARR_SORT_KEY_FLOAT;
+    size_t item_size = dyn_arr->item_size;
+
+    if ((key_width != 1 && key_width != 2 && key_width != 4 && key_width != 8) || (is_signed && is_float) ||
+        (is_float && key_width < 4) || key_width > item_size || key_offset > item_size - key_width)
+    {
+        return false;
+    }
+
+    radix_key_t key = {.offset = key_offset, .width = key_width, .sign = 1ULL << (key_width * 8 - 1)};
+    if (is_signed)
+    {
+        key.neg_flip = key.sign;
+        key.pos_flip = key.sign;
+    }
+    else if (is_float)
+    {
+        key.neg_flip = key.sign | (key.sign - 1);
+        key.pos_flip = key.sign;
+    }
+
+    size_t len = end_index - start_index + 1;
+    size_t counts[8][256] = {{0}};
+
+    for (size_t index = start_index; index <= end_index;)
+    {
+        const char *span;
+        size_t stride;
+        size_t count = dyn_arr_peek(dyn_arr, index, end_index, &span, &stride);
+        if (!count)
+        {
+            return false;
+        }
+
+        if (!stride)
+        {
+            uint64_t value = radix_key(&key, span);
+            for (size_t digit = 0; digit < key_width; digit++)
+            {
+                counts[digit][(value >> (digit * 8)) & 0xFF] += count;
+            }
+        }
+        else
+        {
+            for (size_t item = 0; item < count; item++, span += stride)
+            {
+                uint64_t value = radix_key(&key, span);
+                for (size_t digit = 0; digit < key_width; digit++)
+                {
+                    counts[digit][(value >> (digit * 8)) & 0xFF]++;
+                }
+            }
+        }
+
+        if (end_index - index < count)
+        {
+            break;
+        }
+        index += count;
+    }
+
+    size_t passes[8];
+    size_t num_of_passes = 0;
+    for (size_t digit = 0; digit < key_width; digit++)
+    {
+        bool trivial = false;
+        for (size_t bucket = 0; bucket < 256 && !trivial; bucket++)
+        {
+            trivial = counts[digit][bucket] == len;
+        }
+
+        if (!trivial)
+        {
+            passes[num_of_passes++] = digit;
+        }
+    }
+
+    // every key is the same, so a stable sort leaves the range as it is
+    if (!num_of_passes)
+    {
+        return true;
+    }
+
+    size_t buffers = num_of_passes > 1 ? 2 : 1;
+    if (len > SIZE_MAX / item_size / buffers)
+    {
+        return false;
+    }
+
+    char *scratch = (char *)malloc(buffers * len * item_size);
+    if (!scratch)
+    {
+        return false;
+    }
+
+    char *src = NULL;
+    char *dst = scratch;
+
+    for (size_t pass = 0; pass < num_of_passes; pass++)
+    {
+        size_t digit = passes[pass];
+        unsigned shift = (unsigned)(digit * 8);
+        size_t offsets[256];
+        size_t total = 0;
+
+        for (size_t bucket = 0; bucket < 256; bucket++)
+        {
+            offsets[bucket] = total;
+            total += counts[digit][bucket];
+        }
+
+        if (!src)
+        {
+            for (size_t index = start_index; index <= end_index;)
+            {
+                const char *span;
+                size_t stride;
+                size_t count = dyn_arr_peek(dyn_arr, index, end_index, &span, &stride);
+
+                radix_scatter(span, count, stride, dst, offsets, shift, &key, item_size);
+
+                if (end_index - index < count)
+                {
+                    break;
+                }
+                index += count;
+            }
+        }
+        else
+        {
+            radix_scatter(src, len, item_size, dst, offsets, shift, &key, item_size);
+        }
+
+        src = dst;
+        dst = dst == scratch ? scratch + len * item_size : scratch;
+    }
+
+    bool ok = dyn_arr_write_range(dyn_arr, start_index, src, len, false);
+    free(scratch);
+    return ok;
+}
+
+bool dyn_arr_append(dyn_arr_t *dyn_arr, const void *item)
+{
+    if (!dyn_arr || !item)
+    {
+        return false;
+    }
+
+    if (dyn_arr->is_empty)
+    {
+        dyn_arr->is_empty = false;
+        return dyn_arr_set(dyn_arr, 0, item);
+    }
+
+    return dyn_arr_set(dyn_arr, dyn_arr->last_index + 1, item);
+}
+
+// typed reductions: the range is walked run by run as with dyn_arr_extreme, and each contiguous run is handed
+// to a kernel for the element type; the kernels are plain loops, replaced by AVX2 ones when the CPU has it
+// min/max/argmin/argmax look at the range in blocks of REDUCE_BLOCK items and remember the best block, so the
+// position of the extreme costs one rescan of that block instead of a second pass over the range
+
+// one item of any of the types, or a sum; the kernels reach it through a pointer to the member they work on
+typedef union
+{
+    int32_t i32;
+    int64_t i64;
+    uint32_t u32;
+    uint64_t u64;
+    float f32;
+    double f64;
+} reduce_value_t;
+
+typedef struct
+{
+    size_t width;
+    void (*identity)(bool want_max, void *value);                                 // a value every item beats (or ties)
+    void (*extreme)(const void *items, size_t count, bool want_max, void *value); // folds items into value
+    bool (*better)(const void *a, const void *b, bool want_max);                  // a strictly beats b
+    size_t (*find)(const void *items, size_t count, const void *value);           // first item equal to value, or count
+    void (*sum)(const void *items, size_t count, void *total);                    // adds items to total
+    void (*sum_repeat)(const void *item, size_t count, void *total);              // adds count copies of item to total
+    size_t (*count_if)(const void *items, size_t count, uint32_t cmp, const void *operand);
+} reduce_kernels_t;
+
+// the scalar kernels; integer sums are taken modulo 2^64 in a uint64_t, which is also the two's complement
+// int64_t sum, and float sums in a double
+// floats: a NaN never compares less or greater, so min/max skip NaNs, and a NaN matches only DYN_ARR_CMP_NE
+#define REDUCE_SCALAR_KERNELS(name, T, SUM_T, LOWEST, HIGHEST)                                        \
+    static void reduce_##name##_identity(bool want_max, void *value)                                 \
+    {                                                                                                 \
+        *(T *)value = want_max ? (LOWEST) : (HIGHEST);                                                \
+    }                                                                                                 \
+                                                                                                      \
+    static void reduce_##name##_extreme(const void *items, size_t count, bool want_max, void *value)  \
+    {                                                                                                 \
+        const T *x = (const T *)items;                                                                \
+        T best = *(T *)value;                                                                         \
+        if (want_max)                                                                                 \
+        {                                                                                             \
+            for (size_t i = 0; i < count; i++)                                                        \
+                best = x[i] > best ? x[i] : best;                                                     \
+        }                                                                                             \
+        else                                                                                          \
+        {                                                                                             \
+            for (size_t i = 0; i < count; i++)                                                        \
+                best = x[i] < best ? x[i] : best;                                                     \
+        }                                                                                             \
+        *(T *)value = best;                                                                           \
+    }                                                                                                 \
+                                                                                                      \
+    static bool reduce_##name##_better(const void *a, const void *b, bool want_max)                  \
+    {                                                                                                 \
+        return want_max ? *(const T *)a > *(const T *)b : *(const T *)a < *(const T *)b;              \
+    }                                                                                                 \
+                                                                                                      \
+    static size_t reduce_##name##_find(const void *items, size_t count, const void *value)            \
+    {                                                                                                 \
+        const T *x = (const T *)items;                                                                \
+        T target = *(const T *)value;                                                                 \
+        for (size_t i = 0; i < count; i++)                                                            \
+        {                                                                                             \
+            if (x[i] == target)                                                                       \
+                return i;                                                                             \
+        }                                                                                             \
+        return count;                                                                                 \
+    }                                                                                                 \
+                                                                                                      \
+    static void reduce_##name##_sum(const void *items, size_t count, void *total)                     \
+    {                                                                                                 \
+        const T *x = (const T *)items;                                                                \
+        SUM_T sum = *(SUM_T *)total;                                                                  \
+        for (size_t i = 0; i < count; i++)                                                            \
+            sum += (SUM_T)x[i];                                                                       \
+        *(SUM_T *)total = sum;                                                                        \
+    }                                                                                                 \
+                                                                                                      \
+    static void reduce_##name##_sum_repeat(const void *item, size_t count, void *total)               \
+    {                                                                                                 \
+        *(SUM_T *)total += (SUM_T) * (const T *)item * (SUM_T)count;                                  \
+    }                                                                                                 \
+                                                                                                      \
+    static size_t reduce_##name##_count_if(const void *items, size_t count, uint32_t cmp, const void *operand) \
+    {                                                                                                 \
+        const T *x = (const T *)items;                                                                \
+        T v = *(const T *)operand;                                                                    \
+        size_t n = 0;                                                                                 \
+        switch (cmp)                                                                                  \
+        {                                                                                             \
+        case DYN_ARR_CMP_LT:                                                                          \
+            for (size_t i = 0; i < count; i++)                                                        \
+                n += x[i] < v;                                                                        \
+            break;                                                                                    \
+        case DYN_ARR_CMP_LE:                                                                          \
+            for (size_t i = 0; i < count; i++)                                                        \
+                n += x[i] <= v;                                                                       \
+            break;                                                                                    \
+        case DYN_ARR_CMP_EQ:                                                                          \
+            for (size_t i = 0; i < count; i++)                                                        \
+                n += x[i] == v;                                                                       \
+            break;                                                                                    \
+        case DYN_ARR_CMP_NE:                                                                          \
+            for (size_t i = 0; i < count; i++)                                                        \
+                n += x[i] != v;                                                                       \
+            break;                                                                                    \
+        case DYN_ARR_CMP_GE:                                                                          \
+            for (size_t i = 0; i < count; i++)                                                        \
+                n += x[i] >= v;                                                                       \
+            break;                                                                                    \
+        default:                                                                                      \
+            for (size_t i = 0; i < count; i++)                                                        \
+                n += x[i] > v;                                                                        \
+            break;                                                                                    \
+        }                                                                                             \
+        return n;                                                                                     \
+    }
+
+REDUCE_SCALAR_KERNELS(i32, int32_t, uint64_t, INT32_MIN, INT32_MAX)
+REDUCE_SCALAR_KERNELS(i64, int64_t, uint64_t, INT64_MIN, INT64_MAX)
+REDUCE_SCALAR_KERNELS(u32, uint32_t, uint64_t, 0, UINT32_MAX)
+REDUCE_SCALAR_KERNELS(u64, uint64_t, uint64_t, 0, UINT64_MAX)
+REDUCE_SCALAR_KERNELS(f32, float, double, -HUGE_VALF, HUGE_VALF)
+REDUCE_SCALAR_KERNELS(f64, double, double, -HUGE_VAL, HUGE_VAL)
+
+#define REDUCE_KERNELS(name, T, prefix)                                                                             \
+    {                                                                                                               \
+        sizeof(T), reduce_##name##_identity, prefix##name##_extreme, reduce_##name##_better, reduce_##name##_find, \
+            prefix##name##_sum, reduce_##name##_sum_repeat, prefix##name##_count_if                                 \
+    }
+
+// indexed by DYN_ARR_TYPE_*
+static const reduce_kernels_t reduce_scalar[] = {
+    REDUCE_KERNELS(i32, int32_t, reduce_), REDUCE_KERNELS(i64, int64_t, reduce_), REDUCE_KERNELS(u32, uint32_t, reduce_),
+    REDUCE_KERNELS(u64, uint64_t, reduce_), REDUCE_KERNELS(f32, float, reduce_),  REDUCE_KERNELS(f64, double, reduce_),
+};
+
+#ifdef DYN_ARR_HAVE_X86_SIMD
+
+// AVX2 kernels: each loop takes two vectors per step, folds the lanes at the end, and leaves the tail that does
+// not fill a step to the scalar kernel; the per-type pieces below are macros so they inline into target("avx2")
+// functions without needing the attribute themselves
+
+#define AVX2_SIGN32 _mm256_set1_epi32(INT32_MIN)
+#define AVX2_SIGN64 _mm256_set1_epi64x(INT64_MIN)
+
+#define AVX2_LOAD_I(p) _mm256_loadu_si256((const __m256i *)(p))
+#define AVX2_SET1_i32(v) _mm256_set1_epi32(v)
+#define AVX2_SET1_u32(v) _mm256_set1_epi32((int32_t)(v))
+#define AVX2_SET1_i64(v) _mm256_set1_epi64x(v)
+#define AVX2_SET1_u64(v) _mm256_set1_epi64x((int64_t)(v))
+
+// min/max as (accumulator, items); for floats the items come first, so a NaN item leaves the accumulator alone
+#define AVX2_MIN_i32(acc, x) _mm256_min_epi32(acc, x)
+#define AVX2_MAX_i32(acc, x) _mm256_max_epi32(acc, x)
+#define AVX2_MIN_u32(acc, x) _mm256_min_epu32(acc, x)
+#define AVX2_MAX_u32(acc, x) _mm256_max_epu32(acc, x)
+#define AVX2_MIN_i64(acc, x) _mm256_blendv_epi8(acc, x, _mm256_cmpgt_epi64(acc, x))
+#define AVX2_MAX_i64(acc, x) _mm256_blendv_epi8(acc, x, _mm256_cmpgt_epi64(x, acc))
+#define AVX2_GT_u64(a, b) _mm256_cmpgt_epi64(_mm256_xor_si256(a, AVX2_SIGN64), _mm256_xor_si256(b, AVX2_SIGN64))
+#define AVX2_MIN_u64(acc, x) _mm256_blendv_epi8(acc, x, AVX2_GT_u64(acc, x))
+#define AVX2_MAX_u64(acc, x) _mm256_blendv_epi8(acc, x, AVX2_GT_u64(x, acc))
+
+// greater-than and equal masks for the integer count_if; the other four compares are counted from these
+#define AVX2_GT_i32(a, b) _mm256_cmpgt_epi32(a, b)
+#define AVX2_GT_u32(a, b) _mm256_cmpgt_epi32(_mm256_xor_si256(a, AVX2_SIGN32), _mm256_xor_si256(b, AVX2_SIGN32))
+#define AVX2_GT_i64(a, b) _mm256_cmpgt_epi64(a, b)
+#define AVX2_EQ_i32(a, b) _mm256_cmpeq_epi32(a, b)
+#define AVX2_EQ_u32(a, b) _mm256_cmpeq_epi32(a, b)
+#define AVX2_EQ_i64(a, b) _mm256_cmpeq_epi64(a, b)
+#define AVX2_EQ_u64(a, b) _mm256_cmpeq_epi64(a, b)
+
+// sums widen into two vectors of four 64-bit lanes
+#define AVX2_SUM_i32(lo, hi, x)                                                              \
+    do                                                                                       \
+    {                                                                                        \
+        lo = _mm256_add_epi64(lo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)));         \
+        hi = _mm256_add_epi64(hi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)));    \
+    } while (0)
+#define AVX2_SUM_u32(lo, hi, x)                                                              \
+    do                                                                                       \
+    {                                                                                        \
+        lo = _mm256_add_epi64(lo, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(x)));         \
+        hi = _mm256_add_epi64(hi, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(x, 1)));    \
+    } while (0)
+
+#define AVX2_INT_KERNELS(name, T, LANES)                                                                           \
+    __attribute__((target("avx2"))) static void avx2_##name##_extreme(const void *items, size_t count,            \
+                                                                      bool want_max, void *value)                 \
+    {                                                                                                              \
+        const T *x = (const T *)items;                                                                             \
+        size_t steps = count / (2 * LANES);                                                                        \
+        if (steps)                                                                                                 \
+        {                                                                                                          \
+            __m256i acc0 = AVX2_SET1_##name(*(T *)value);                                                          \
+            __m256i acc1 = acc0;                                                                                   \
+            if (want_max)                                                                                          \
+            {                                                                                                      \
+                for (size_t i = 0; i < steps; i++, x += 2 * LANES)                                                 \
+                {                                                                                                  \
+                    acc0 = AVX2_MAX_##name(acc0, AVX2_LOAD_I(x));                                                  \
+                    acc1 = AVX2_MAX_##name(acc1, AVX2_LOAD_I(x + LANES));                                          \
+                }                                                                                                  \
+                acc0 = AVX2_MAX_##name(acc0, acc1);                                                                \
+            }                                                                                                      \
+            else                                                                                                   \
+            {                                                                                                      \
+                for (size_t i = 0; i < steps; i++, x += 2 * LANES)                                                 \
+                {                                                                                                  \
+                    acc0 = AVX2_MIN_##name(acc0, AVX2_LOAD_I(x));                                                  \
+                    acc1 = AVX2_MIN_##name(acc1, AVX2_LOAD_I(x + LANES));                                          \
+                }                                                                                                  \
+                acc0 = AVX2_MIN_##name(acc0, acc1);                                                                \
+            }                                                                                                      \
+            T lanes[LANES];                                                                                        \
+            _mm256_storeu_si256((__m256i *)lanes, acc0);                                                           \
+            reduce_##name##_extreme(lanes, LANES, want_max, value);                                                \
+        }                                                                                                          \
+        reduce_##name##_extreme(x, count - steps * 2 * LANES, want_max, value);                                    \
+    }                                                                                                              \
+                                                                                                                   \
+    __attribute__((target("avx2"))) static size_t avx2_##name##_count_if(const void *items, size_t count,         \
+                                                                         uint32_t cmp, const void *operand)        \
+    {                                                                                                              \
+        const T *x = (const T *)items;                                                                             \
+        size_t steps = count / (2 * LANES);                                                                        \
+        size_t n = 0;                                                                                              \
+        if (steps)                                                                                                 \
+        {                                                                                                          \
+            __m256i v = AVX2_SET1_##name(*(const T *)operand);                                                     \
+            size_t bits = 0; /* mask bytes set, sizeof(T) per matching item */                                     \
+            if (cmp == DYN_ARR_CMP_EQ || cmp == DYN_ARR_CMP_NE)                                                    \
+            {                                                                                                      \
+                for (size_t i = 0; i < steps; i++, x += 2 * LANES)                                                 \
+                {                                                                                                  \
+                    bits += (size_t)__builtin_popcount((uint32_t)_mm256_movemask_epi8(AVX2_EQ_##name(AVX2_LOAD_I(x), v))); \
+                    bits += (size_t)__builtin_popcount((uint32_t)_mm256_movemask_epi8(AVX2_EQ_##name(AVX2_LOAD_I(x + LANES), v))); \
+                }                                                                                                  \
+            }                                                                                                      \
+            else if (cmp == DYN_ARR_CMP_GT || cmp == DYN_ARR_CMP_LE)                                               \
+            {                                                                                                      \
+                for (size_t i = 0; i < steps; i++, x += 2 * LANES)                                                 \
+                {                                                                                                  \
+                    bits += (size_t)__builtin_popcount((uint32_t)_mm256_movemask_epi8(AVX2_GT_##name(AVX2_LOAD_I(x), v))); \
+                    bits += (size_t)__builtin_popcount((uint32_t)_mm256_movemask_epi8(AVX2_GT_##name(AVX2_LOAD_I(x + LANES), v))); \
+                }                                                                                                  \
+            }                                                                                                      \
+            else                                                                                                   \
+            {                                                                                                      \
+                for (size_t i = 0; i < steps; i++, x += 2 * LANES)                                                 \
+                {                                                                                                  \
+                    bits += (size_t)__builtin_popcount((uint32_t)_mm256_movemask_epi8(AVX2_GT_##name(v, AVX2_LOAD_I(x)))); \
+                    bits += (size_t)__builtin_popcount((uint32_t)_mm256_movemask_epi8(AVX2_GT_##name(v, AVX2_LOAD_I(x + LANES)))); \
+                }                                                                                                  \
+            }                                                                                                      \
+            n = bits / sizeof(T);                                                                                  \
+            /* EQ, GT and LT were counted; NE, LE and GE are what is left */                                       \
+            if (cmp == DYN_ARR_CMP_NE || cmp == DYN_ARR_CMP_LE || cmp == DYN_ARR_CMP_GE)                           \
+                n = steps * 2 * LANES - n;                                                                         \
+        }                                                                                                          \
+        return n + reduce_##name##_count_if(x, count - steps * 2 * LANES, cmp, operand);                           \
+    }
+
+#define AVX2_INT_SUM_KERNEL(name, T, LANES, WIDEN)                                                            \
+    __attribute__((target("avx2"))) static void avx2_##name##_sum(const void *items, size_t count, void *total) \
+    {                                                                                                         \
+        const T *x = (const T *)items;                                                                        \
+        size_t steps = count / LANES;                                                                         \
+        if (steps)                                                                                            \
+        {                                                                                                     \
+            __m256i lo = _mm256_setzero_si256();                                                              \
+            __m256i hi = _mm256_setzero_si256();                                                              \
+            for (size_t i = 0; i < steps; i++, x += LANES)                                                    \
+                WIDEN(lo, hi, AVX2_LOAD_I(x));                                                                \
+            uint64_t lanes[4];                                                                                \
+            _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(lo, hi));                                  \
+            *(uint64_t *)total += lanes[0] + lanes[1] + lanes[2] + lanes[3];                                  \
+        }                                                                                                     \
+        reduce_##name##_sum(x, count - steps * LANES, total);                                                 \
+    }
+
+// 64-bit items need no widening, so they all go into the first accumulator
+#define AVX2_SUM_64(lo, hi, x) lo = _mm256_add_epi64(lo, x)
+
+AVX2_INT_KERNELS(i32, int32_t, 8)
+AVX2_INT_KERNELS(u32, uint32_t, 8)
+AVX2_INT_KERNELS(i64, int64_t, 4)
+AVX2_INT_KERNELS(u64, uint64_t, 4)
+AVX2_INT_SUM_KERNEL(i32, int32_t, 8, AVX2_SUM_i32)
+AVX2_INT_SUM_KERNEL(u32, uint32_t, 8, AVX2_SUM_u32)
+AVX2_INT_SUM_KERNEL(i64, int64_t, 4, AVX2_SUM_64)
+AVX2_INT_SUM_KERNEL(u64, uint64_t, 4, AVX2_SUM_64)
+
+// the float compares take an immediate, so count_if has one loop per predicate; the ordered predicates are
+// false for a NaN and the unordered not-equal is true, as with C's operators
+#define AVX2_FLOAT_COUNT(LANES, LOAD, CMP, MOVEMASK, PRED)                                    \
+    for (size_t i = 0; i < steps; i++, x += 2 * LANES)                                       \
+    {                                                                                        \
+        n += (size_t)__builtin_popcount((uint32_t)MOVEMASK(CMP(LOAD(x), v, PRED)));          \
+        n += (size_t)__builtin_popcount((uint32_t)MOVEMASK(CMP(LOAD(x + LANES), v, PRED)));  \
+    }
+
+#define AVX2_FLOAT_KERNELS(name, T, VT, LANES, LOAD, STORE, SET1, VMIN, VMAX, CMP, MOVEMASK)                 \
+    __attribute__((target("avx2"))) static void avx2_##name##_extreme(const void *items, size_t count,       \
+                                                                      bool want_max, void *value)            \
+    {                                                                                                         \
+        const T *x = (const T *)items;                                                                        \
+        size_t steps = count / (2 * LANES);                                                                   \
+        if (steps)                                                                                            \
+        {                                                                                                     \
+            VT acc0 = SET1(*(T *)value);                                                                      \
+            VT acc1 = acc0;                                                                                   \
+            if (want_max)                                                                                     \
+            {                                                                                                 \
+                for (size_t i = 0; i < steps; i++, x += 2 * LANES)                                            \
+                {                                                                                             \
+                    acc0 = VMAX(LOAD(x), acc0);                                                               \
+                    acc1 = VMAX(LOAD(x + LANES), acc1);                                                       \
+                }                                                                                             \
+            }                                                                                                 \
+            else                                                                                              \
+            {                                                                                                 \
+                for (size_t i = 0; i < steps; i++, x += 2 * LANES)                                            \
+                {                                                                                             \
+                    acc0 = VMIN(LOAD(x), acc0);                                                               \
+                    acc1 = VMIN(LOAD(x + LANES), acc1);                                                       \
+                }                                                                                             \
+            }                                                                                                 \
+            T lanes[2 * LANES];                                                                               \
+            STORE(lanes, acc0);                                                                               \
+            STORE(lanes + LANES, acc1);                                                                       \
+            reduce_##name##_extreme(lanes, 2 * LANES, want_max, value);                                       \
+        }                                                                                                     \
+        reduce_##name##_extreme(x, count - steps * 2 * LANES, want_max, value);                               \
+    }                                                                                                         \
+                                                                                                              \
+    __attribute__((target("avx2"))) static size_t avx2_##name##_count_if(const void *items, size_t count,    \
+                                                                         uint32_t cmp, const void *operand)   \
+    {                                                                                                         \
+        const T *x = (const T *)items;                                                                        \
+        size_t steps = count / (2 * LANES);                                                                   \
+        size_t n = 0;                                                                                         \
+        VT v = SET1(*(const T *)operand);                                                                     \
+        switch (cmp)                                                                                          \
+        {                                                                                                     \
+        case DYN_ARR_CMP_LT:                                                                                  \
+            AVX2_FLOAT_COUNT(LANES, LOAD, CMP, MOVEMASK, _CMP_LT_OQ)                                                                      \
+            break;                                                                                            \
+        case DYN_ARR_CMP_LE:                                                                                  \
+            AVX2_FLOAT_COUNT(LANES, LOAD, CMP, MOVEMASK, _CMP_LE_OQ)                                                                      \
+            break;                                                                                            \
+        case DYN_ARR_CMP_EQ:                                                                                  \
+            AVX2_FLOAT_COUNT(LANES, LOAD, CMP, MOVEMASK, _CMP_EQ_OQ)                                                                      \
+            break;                                                                                            \
+        case DYN_ARR_CMP_NE:                                                                                  \
+            AVX2_FLOAT_COUNT(LANES, LOAD, CMP, MOVEMASK, _CMP_NEQ_UQ)                                                                     \
+            break;                                                                                            \
+        case DYN_ARR_CMP_GE:                                                                                  \
+            AVX2_FLOAT_COUNT(LANES, LOAD, CMP, MOVEMASK, _CMP_GE_OQ)                                                                      \
+            break;                                                                                            \
+        default:                                                                                              \
+            AVX2_FLOAT_COUNT(LANES, LOAD, CMP, MOVEMASK, _CMP_GT_OQ)                                                                      \
+            break;                                                                                            \
+        }                                                                                                     \
+        return n + reduce_##name##_count_if(x, count - steps * 2 * LANES, cmp, operand);                      \
+    }
+
+#define AVX2_FLOAT_SUM_KERNEL(name, T, LANES, LOAD, ADD_WIDENED)                                           \
+    __attribute__((target("avx2"))) static void avx2_##name##_sum(const void *items, size_t count, void *total) \
+    {                                                                                                         \
+        const T *x = (const T *)items;                                                                        \
+        size_t steps = count / LANES;                                                                         \
+        if (steps)                                                                                            \
+        {                                                                                                     \
+            __m256d lo = _mm256_setzero_pd();                                                                 \
+            __m256d hi = _mm256_setzero_pd();                                                                 \
+            for (size_t i = 0; i < steps; i++, x += LANES)                                                    \
+                ADD_WIDENED(lo, hi, LOAD(x));                                                                 \
+            double lanes[4];                                                                                  \
+            _mm256_storeu_pd(lanes, _mm256_add_pd(lo, hi));                                                   \
+            *(double *)total += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);                                \
+        }                                                                                                     \
+        reduce_##name##_sum(x, count - steps * LANES, total);                                                 \
+    }
+
+#define AVX2_SUM_f32(lo, hi, x)                                                        \
+    do                                                                                 \
+    {                                                                                  \
+        __m256 wide = (x);                                                             \
+        lo = _mm256_add_pd(lo, _mm256_cvtps_pd(_mm256_castps256_ps128(wide)));         \
+        hi = _mm256_add_pd(hi, _mm256_cvtps_pd(_mm256_extractf128_ps(wide, 1)));       \
+    } while (0)
+#define AVX2_SUM_f64(lo, hi, x) lo = _mm256_add_pd(lo, x)
+
+AVX2_FLOAT_KERNELS(f32, float, __m256, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps, _mm256_min_ps,
+                   _mm256_max_ps, _mm256_cmp_ps, _mm256_movemask_ps)
+AVX2_FLOAT_KERNELS(f64, double, __m256d, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, _mm256_min_pd,
+                   _mm256_max_pd, _mm256_cmp_pd, _mm256_movemask_pd)
+AVX2_FLOAT_SUM_KERNEL(f32, float, 8, _mm256_loadu_ps, AVX2_SUM_f32)
+AVX2_FLOAT_SUM_KERNEL(f64, double, 4, _mm256_loadu_pd, AVX2_SUM_f64)
+
+static const reduce_kernels_t reduce_avx2[] = {
+    REDUCE_KERNELS(i32, int32_t, avx2_), REDUCE_KERNELS(i64, int64_t, avx2_), REDUCE_KERNELS(u32, uint32_t, avx2_),
+    REDUCE_KERNELS(u64, uint64_t, avx2_), REDUCE_KERNELS(f32, float, avx2_),  REDUCE_KERNELS(f64, double, avx2_),
+};
+
+#endif
+
+static pthread_once_t reduce_once = PTHREAD_ONCE_INIT;
+static const reduce_kernels_t *reduce_table = reduce_scalar;
+
+static void reduce_init(void)
+{
+#ifdef DYN_ARR_HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2"))
+    {
+        reduce_table = reduce_avx2;
+    }
+#endif
+}
+
+static const reduce_kernels_t *reduce_kernels(const dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type)
+{
+    if (!dyn_arr || start_index > end_index || type > DYN_ARR_TYPE_F64)
+    {
+        return NULL;
+    }
+
+    pthread_once(&reduce_once, reduce_init);
+
+    const reduce_kernels_t *kernels = &reduce_table[type];
+    return dyn_arr->item_size == kernels->width ? kernels : NULL;
+}
+
+typedef void (*reduce_run_fn)(const char *items, size_t count, size_t stride, size_t index, void *state);
+
+// hands each run of the range to fn, skipping chunks that were never allocated; as with dyn_arr_min, the
+// range has to start in one that was
+static bool reduce_walk(const dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, reduce_run_fn fn, void *state)
+{
+    for (size_t index = start_index; index <= end_index;)
+    {
+        const char *span;
+        size_t stride;
+        size_t count = dyn_arr_peek(dyn_arr, index, end_index, &span, &stride);
+        if (!count)
+        {
+            if (index == start_index)
+            {
+                return false;
+            }
+
+            if ((index | (MAX_NODE_SIZE - 1)) >= end_index)
+            {
+                break;
+            }
+            index = (index | (MAX_NODE_SIZE - 1)) + 1;
+            continue;
+        }
+
+        fn(span, count, stride, index, state);
+
+        if (end_index - index < count)
+        {
+            break;
+        }
+        index += count;
+    }
+
+    return true;
+}
+
+typedef struct
+{
+    const reduce_kernels_t *kernels;
+    bool want_max;
+    reduce_value_t best; // the best value so far
+    const char *block;  // the block it came from
+    size_t block_len;
+    size_t block_index; // index of the block's first item
+} reduce_extreme_t;
+
+static void reduce_extreme_run(const char *items, size_t count, size_t stride, size_t index, void *state)
+{
+    reduce_extreme_t *extreme = (reduce_extreme_t *)state;
+    const reduce_kernels_t *kernels = extreme->kernels;
+
+    // a run past the mark is count copies of the default, so its first item stands for all of it
+    if (!stride)
+    {
+        count = 1;
+    }
+
+    for (size_t done = 0; done < count; done += REDUCE_BLOCK)
+    {
+        size_t len = count - done < REDUCE_BLOCK ? count - done : REDUCE_BLOCK;
+        const char *block = items + done * kernels->width;
+        reduce_value_t value;
+
+        kernels->identity(extreme->want_max, &value);
+        kernels->extreme(block, len, extreme->want_max, &value);
+
+        if (!extreme->block || kernels->better(&value, &extreme->best, extreme->want_max))
+        {
+            extreme->best = value;
+            extreme->block = block;
+            extreme->block_len = len;
+            extreme->block_index = index + done;
+        }
+    }
+}
+
+typedef struct
+{
+    const reduce_kernels_t *kernels;
+    reduce_value_t value;
+    bool found;
+    size_t index;
+} reduce_find_t;
+
+static void reduce_find_run(const char *items, size_t count, size_t stride, size_t index, void *state)
+{
+    reduce_find_t *find = (reduce_find_t *)state;
+    if (find->found)
+    {
+        return;
+    }
+
+    size_t at = find->kernels->find(items, stride ? count : 1, &find->value);
+    if (at < (stride ? count : 1))
+    {
+        find->found = true;
+        find->index = index + at;
+    }
+}
+
+static bool reduce_extreme(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type, bool want_max,
+                           void *output, size_t *position)
+{
+    const reduce_kernels_t *kernels = reduce_kernels(dyn_arr, start_index, end_index, type);
+    if (!kernels)
+    {
+        return false;
+    }
+
+    reduce_extreme_t extreme = {.kernels = kernels, .want_max = want_max};
+    if (!reduce_walk(dyn_arr, start_index, end_index, reduce_extreme_run, &extreme))
+    {
+        return false;
+    }
+
+    // the first item equal to the best value; it is nearly always in the best block, but when every item of that
+    // block was a NaN the value is only the identity, and some later block may hold it for real
+    reduce_find_t find = {.kernels = kernels, .value = extreme.best};
+    size_t at = kernels->find(extreme.block, extreme.block_len, &extreme.best);
+    if (at < extreme.block_len)
+    {
+        find.found = true;
+        find.index = extreme.block_index + at;
+    }
+    else
+    {
+        reduce_walk(dyn_arr, start_index, end_index, reduce_find_run, &find);
+    }
+
+    // no item matched, so there were only NaNs; report the first of them
+    if (!find.found)
+    {
+        const char *span;
+        size_t stride;
+        dyn_arr_peek(dyn_arr, start_index, start_index, &span, &stride);
+        memcpy(&extreme.best, span, kernels->width);
+        find.index = start_index;
+    }
+
+    if (output)
+    {
+        memcpy(output, &extreme.best, kernels->width);
+    }
+    if (position)
+    {
+        *position = find.index;
+    }
+
+    return true;
+}
+
+bool dyn_arr_reduce_min(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type, void *output)
+{
+    return output && reduce_extreme(dyn_arr, start_index, end_index, type, false, output, NULL);
+}
+
+bool dyn_arr_reduce_max(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type, void *output)
+{
+    return output && reduce_extreme(dyn_arr, start_index, end_index, type, true, output, NULL);
+}
+
+bool dyn_arr_reduce_argmin(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type, size_t *index)
+{
+    return index && reduce_extreme(dyn_arr, start_index, end_index, type, false, NULL, index);
+}
+
+bool dyn_arr_reduce_argmax(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type, size_t *index)
+{
+    return index && reduce_extreme(dyn_arr, start_index, end_index, type, true, NULL, index);
+}
+
+typedef struct
+{
+    const reduce_kernels_t *kernels;
+    reduce_value_t total; // u64 for integer types, f64 for floats
+    uint32_t cmp;
+    const void *operand;
+    size_t count;
+} reduce_fold_t;
+
+static void reduce_sum_run(const char *items, size_t count, size_t stride, size_t index, void *state)
+{
+    reduce_fold_t *fold = (reduce_fold_t *)state;
+    (void)index;
+
+    if (stride)
+    {
+        fold->kernels->sum(items, count, &fold->total);
+    }
+    else
+    {
+        fold->kernels->sum_repeat(items, count, &fold->total);
+    }
+}
+
+bool dyn_arr_reduce_sum(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type, void *output)
+{
+    const reduce_kernels_t *kernels = reduce_kernels(dyn_arr, start_index, end_index, type);
+    if (!kernels || !output)
+    {
+        return false;
+    }
+
+    reduce_fold_t fold = {.kernels = kernels};
+    if (type == DYN_ARR_TYPE_F32 || type == DYN_ARR_TYPE_F64)
+    {
+        fold.total.f64 = 0.0;
+    }
+
+    if (!reduce_walk(dyn_arr, start_index, end_index, reduce_sum_run, &fold))
+    {
+        return false;
+    }
+
+    memcpy(output, &fold.total, sizeof(fold.total));
+    return true;
+}
+
+static void reduce_count_run(const char *items, size_t count, size_t stride, size_t index, void *state)
+{
+    reduce_fold_t *fold = (reduce_fold_t *)state;
+    (void)index;
+
+    if (stride)
+    {
+        fold->count += fold->kernels->count_if(items, count, fold->cmp, fold->operand);
+    }
+    else if (fold->kernels->count_if(items, 1, fold->cmp, fold->operand))
+    {
+        fold->count += count;
+    }
+}
+
+bool dyn_arr_reduce_count_if(dyn_arr_t *dyn_arr, size_t start_index, size_t end_index, uint32_t type,
+                             uint32_t cmp, const void *operand, size_t *count)
+{
+    const reduce_kernels_t *kernels = reduce_kernels(dyn_arr, start_index, end_index, type);
+    if (!kernels || !operand || !count || cmp > DYN_ARR_CMP_GT)
+    {
+        return false;
+    }
+
+    reduce_fold_t fold = {.kernels = kernels, .cmp = cmp, .operand = operand};
+    if (!reduce_walk(dyn_arr, start_index, end_index, reduce_count_run, &fold))
+    {
+        return false;
+    }
+
+    *count = fold.count;
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define HASH_DEFAULT_SEED (0x9747b28cULL)
+
+// every container hashes through this signature, so any of the built-ins below (or a caller's own)
+// can be plugged into hash_table_t or map_t
+// bucket indices come from the low bits of the result, so a function must mix well into them
+typedef uint64_t (*hash_fn_t)(const void *key, size_t len, uint64_t seed);
+
+uint64_t hash_fn_wyhash(const void *key, size_t len, uint64_t seed);  // 64-bit, fast on every size; the default
+uint64_t hash_fn_crc32c(const void *key, size_t len, uint64_t seed);  // two independent crc32c lanes, hardware accelerated when the cpu allows
+uint64_t hash_fn_murmur3(const void *key, size_t len, uint64_t seed); // the original 32-bit murmur3 of hash_table_t
+uint64_t hash_fn_xxh32(const void *key, size_t len, uint64_t seed);   // the original 32-bit xxh32 of map_t
+
+#define HASH_FN_DEFAULT (hash_fn_wyhash)
+
+static inline uint64_t hash_reverse_bits(uint64_t x)
+{
+    x = __builtin_bswap64(x);
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return x;
+}
+
+// cursor step shared by the containers' scan calls
+// the cursor counts with its bits reversed, so it walks the high bits of a bucket index first; when a table
+// doubles (or halves) between two calls, the buckets already visited map onto exactly the ones below the cursor,
+// and no bucket holding an unvisited key is skipped; returns 0 once every bucket under mask has been visited
+static inline uint64_t hash_scan_next(uint64_t cursor, uint64_t mask)
+{
+    return hash_reverse_bits(hash_reverse_bits(cursor | ~mask) + 1);
+}
+
+#endif
@@ -0,0 +1,394 @@
+#include "../inc/hash.h"
+
+#include <string.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define HASH_HAVE_X86_CRC 1
+#endif
+
+#define XXH_PRIME32_1 2654435761U
+#define XXH_PRIME32_2 2246822519U
+#define XXH_PRIME32_3 3266489917U
+#define XXH_PRIME32_4 668265263U
+#define XXH_PRIME32_5 374761393U
+
+#define CRC32C_POLY 0x82f63b78U // reflected castagnoli polynomial
+#define CRC32C_LANE_MUL 0x9e3779b97f4a7c15ULL // odd; the second lane crcs every word times this
+
+static inline uint32_t rotl32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+// unaligned little-endian reads; memcpy compiles down to a single load
+static inline uint64_t read64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// murmur3's 64-bit finalizer, used to spread narrower hashes over all 64 bits
+static inline uint64_t fmix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint32_t murmur3_32(const void *key, size_t key_size, uint32_t seed)
+{
+    const uint8_t *data = (const uint8_t *)key;
+    const int nblocks = key_size / 4;
+    uint32_t h = seed;
+    const uint32_t c1 = 0xcc9e2d51;
+    const uint32_t c2 = 0x1b873593;
+
+    const uint32_t *blocks = (const uint32_t *)(data);
+    for (int i = 0; i < nblocks; i++)
+    {
+        uint32_t k = blocks[i];
+        k *= c1;
+        k = (k << 15) | (k >> 17);
+        k *= c2;
+
+        h ^= k;
+        h = (h << 13) | (h >> 19);
+        h = h * 5 + 0xe6546b64;
+    }
+
+    const uint8_t *tail = (const uint8_t *)(data + nblocks * 4);
+    uint32_t k1 = 0;
+    switch (key_size & 3)
+    {
+    case 3:
+        k1 ^= tail[2] << 16;
+        // fall through
+    case 2:
+        k1 ^= tail[1] << 8;
+        // fall through
+    case 1:
+        k1 ^= tail[0];
+        k1 *= c1;
+        k1 = (k1 << 15) | (k1 >> 17);
+        k1 *= c2;
+        h ^= k1;
+    }
+
+    h ^= key_size;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
+}
+
+static uint32_t xxh32(const void *key, size_t len, uint32_t seed)
+{
+    const uint8_t *p = (const uint8_t *)key;
+    uint32_t h32;
+
+    if (len <= 4)
+    {
+        const uint8_t *p = (const uint8_t *)key;
+        uint32_t h32 = seed + XXH_PRIME32_5;
+
+        h32 += (uint32_t)len;
+
+        switch (len)
+        {
+        case 4:
+            h32 += ((uint32_t)p[3]) << 24;
+            // fall through
+        case 3:
+            h32 += ((uint32_t)p[2]) << 16;
+            // fall through
+        case 2:
+            h32 += ((uint32_t)p[1]) << 8;
+            // fall through
+        case 1:
+            h32 += (uint32_t)p[0];
+            h32 *= XXH_PRIME32_3;
+            h32 = rotl32(h32, 17) * XXH_PRIME32_4;
+        }
+
+        h32 ^= h32 >> 15;
+        h32 *= XXH_PRIME32_2;
+        h32 ^= h32 >> 13;
+        h32 *= XXH_PRIME32_3;
+        h32 ^= h32 >> 16;
+
+        return h32;
+    }
+
+    if (len >= 16)
+    {
+        const uint32_t *blocks = (const uint32_t *)p;
+        size_t nblocks = len / 16;
+        uint32_t v1 = seed + XXH_PRIME32_1 + XXH_PRIME32_2;
+        uint32_t v2 = seed + XXH_PRIME32_2;
+        uint32_t v3 = seed + 0;
+        uint32_t v4 = seed - XXH_PRIME32_1;
+
+        for (size_t i = 0; i < nblocks; i++)
+        {
+            v1 += blocks[i * 4] * XXH_PRIME32_2;
+            v1 = rotl32(v1, 13);
+            v1 *= XXH_PRIME32_1;
+
+            v2 += blocks[i * 4 + 1] * XXH_PRIME32_2;
+            v2 = rotl32(v2, 13);
+            v2 *= XXH_PRIME32_1;
+
+            v3 += blocks[i * 4 + 2] * XXH_PRIME32_2;
+            v3 = rotl32(v3, 13);
+            v3 *= XXH_PRIME32_1;
+
+            v4 += blocks[i * 4 + 3] * XXH_PRIME32_2;
+            v4 = rotl32(v4, 13);
+            v4 *= XXH_PRIME32_1;
+        }
+
+        h32 = rotl32(v1, 1) + rotl32(v2, 7) + rotl32(v3, 12) + rotl32(v4, 18);
+    }
+    else
+    {
+        h32 = seed + XXH_PRIME32_5;
+    }
+
+    h32 += (uint32_t)len;
+
+    while (len >= 4)
+    {
+        h32 += (*(const uint32_t *)p) * XXH_PRIME32_3;
+        h32 = rotl32(h32, 17) * XXH_PRIME32_4;
+        p += 4;
+        len -= 4;
+    }
+
+    while (len > 0)
+    {
+        h32 += (*p++) * XXH_PRIME32_5;
+        h32 = rotl32(h32, 11) * XXH_PRIME32_1;
+        len--;
+    }
+
+    h32 ^= h32 >> 15;
+    h32 *= XXH_PRIME32_2;
+    h32 ^= h32 >> 13;
+    h32 *= XXH_PRIME32_3;
+    h32 ^= h32 >> 16;
+
+    return h32;
+}
+
+uint64_t hash_fn_murmur3(const void *key, size_t len, uint64_t seed)
+{
+    return murmur3_32(key, len, (uint32_t)seed);
+}
+
+uint64_t hash_fn_xxh32(const void *key, size_t len, uint64_t seed)
+{
+    return xxh32(key, len, (uint32_t)seed);
+}
+
+static const uint64_t wy_secret[4] = {0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL,
+                                      0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL};
+
+// 64x64 -> 128 multiply folded back to 64 bits
+static inline uint64_t wy_mum(uint64_t a, uint64_t b)
+{
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+// reads up to 3 bytes without branching on the exact length
+static inline uint64_t wy_read3(const uint8_t *p, size_t len)
+{
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+}
+
+uint64_t hash_fn_wyhash(const void *key, size_t len, uint64_t seed)
+{
+    const uint8_t *p = (const uint8_t *)key;
+    uint64_t a;
+    uint64_t b;
+
+    seed ^= wy_mum(seed ^ wy_secret[0], wy_secret[1]);
+
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            // two overlapping 4-byte reads from each end cover every length from 4 to 16
+            a = (read32(p) << 32) | read32(p + ((len >> 3) << 2));
+            b = (read32(p + len - 4) << 32) | read32(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if (len > 0)
+        {
+            a = wy_read3(p, len);
+            b = 0;
+        }
+        else
+        {
+            a = 0;
+            b = 0;
+        }
+    }
+    else
+    {
+        size_t remaining = len;
+        if (remaining > 48)
+        {
+            // three independent lanes keep the multipliers busy on long keys
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+            do
+            {
+                seed = wy_mum(read64(p) ^ wy_secret[1], read64(p + 8) ^ seed);
+                see1 = wy_mum(read64(p + 16) ^ wy_secret[2], read64(p + 24) ^ see1);
+                see2 = wy_mum(read64(p + 32) ^ wy_secret[3], read64(p + 40) ^ see2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= see1 ^ see2;
+        }
+
+        while (remaining > 16)
+        {
+            seed = wy_mum(read64(p) ^ wy_secret[1], read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+
+        // the last 16 bytes, overlapping already-consumed ones if needed
+        a = read64(p + remaining - 16);
+        b = read64(p + remaining - 8);
+    }
+
+    a ^= wy_secret[1];
+    b ^= seed;
+
+    __uint128_t r = (__uint128_t)a * b;
+    a = (uint64_t)r;
+    b = (uint64_t)(r >> 64);
+
+    return wy_mum(a ^ wy_secret[0] ^ len, b ^ wy_secret[1]);
+}
+
+static uint32_t crc32c_table[256];
+static bool crc32c_hardware;
+
+// runs at load time, so hash_fn_crc32c needs no once-guard on every call
+__attribute__((constructor)) static void crc32c_init(void)
+{
+    for (uint32_t index = 0; index < 256; index++)
+    {
+        uint32_t crc = index;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0U - (crc & 1U)));
+        }
+        crc32c_table[index] = crc;
+    }
+
+#ifdef HASH_HAVE_X86_CRC
+    __builtin_cpu_init(); // other constructors may not have run yet
+    crc32c_hardware = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+// the key is taken in 8-byte words, the last one zero-padded; one lane crcs the words as they are, the other
+// crcs each word multiplied by CRC32C_LANE_MUL
+// crc is affine in both its start state and its input, so two lanes over the same words would differ only by a
+// constant and carry 32 bits between them; the multiply is not linear over GF(2), which keeps the lanes apart
+
+static inline uint32_t crc32c_software_u64(uint32_t crc, uint64_t word)
+{
+    for (int byte = 0; byte < 8; byte++, word >>= 8)
+    {
+        crc = crc32c_table[(crc ^ word) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static uint64_t crc32c_software(const uint8_t *p, size_t len, uint32_t lo, uint32_t hi)
+{
+    for (; len >= 8; p += 8, len -= 8)
+    {
+        uint64_t word = read64(p);
+        lo = crc32c_software_u64(lo, word);
+        hi = crc32c_software_u64(hi, word * CRC32C_LANE_MUL);
+    }
+
+    if (len)
+    {
+        uint64_t word = 0;
+        memcpy(&word, p, len);
+        lo = crc32c_software_u64(lo, word);
+        hi = crc32c_software_u64(hi, word * CRC32C_LANE_MUL);
+    }
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+#ifdef HASH_HAVE_X86_CRC
+// a 64-bit crc step is two 32-bit ones over the low half then the high half, which is all i386 has
+#if defined(__x86_64__)
+#define CRC32C_HARDWARE_U64(crc, word) ((uint32_t)_mm_crc32_u64((crc), (word)))
+#else
+#define CRC32C_HARDWARE_U64(crc, word) _mm_crc32_u32(_mm_crc32_u32((crc), (uint32_t)(word)), (uint32_t)((word) >> 32))
+#endif
+
+__attribute__((target("sse4.2"))) static uint64_t crc32c_hardware_lanes(const uint8_t *p, size_t len, uint32_t lo, uint32_t hi)
+{
+    for (; len >= 8; p += 8, len -= 8)
+    {
+        uint64_t word = read64(p);
+        lo = CRC32C_HARDWARE_U64(lo, word);
+        hi = CRC32C_HARDWARE_U64(hi, word * CRC32C_LANE_MUL);
+    }
+
+    if (len)
+    {
+        uint64_t word = 0;
+        memcpy(&word, p, len);
+        lo = CRC32C_HARDWARE_U64(lo, word);
+        hi = CRC32C_HARDWARE_U64(hi, word * CRC32C_LANE_MUL);
+    }
+
+    return ((uint64_t)hi << 32) | lo;
+}
+#endif
+
+uint64_t hash_fn_crc32c(const void *key, size_t len, uint64_t seed)
+{
+    uint32_t lo = (uint32_t)seed;
+    uint32_t hi = (uint32_t)(seed >> 32) ^ (uint32_t)len;
+    uint64_t crc;
+
+#ifdef HASH_HAVE_X86_CRC
+    if (crc32c_hardware)
+        crc = crc32c_hardware_lanes((const uint8_t *)key, len, lo, hi);
+    else
+#endif
+        crc = crc32c_software((const uint8_t *)key, len, lo, hi);
+
+    // the zero padding of the last word is told apart by the length; fmix64 spreads both lanes over every bit
+    return fmix64(crc ^ ((uint64_t)len << 56));
+}
@@ -0,0 +1,154 @@
+#ifndef HASH_MAP_HPP
+#define HASH_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+
+#include "hash_table_typed.h"
+
+// header-only C++ face of hash_table_typed.h: HASH_TABLE_DEFINE is expanded inside the class, so the probing,
+// growth and deletion code is the C engine's, specialized per K and V by the compiler
+// like the C tables, K and V must be trivially copyable; HashFn and Eq are default-constructed for every call,
+// so they must not carry state; get()'s pointer is only good until the next insert or remove
+
+namespace hash_table
+{
+
+// std::hash is the identity for integers on common standard libraries, which is useless as a power-of-two slot index,
+// so its result is mixed once more
+template <typename K>
+struct Hash
+{
+    uint64_t operator()(const K &key) const
+    {
+        return hash_table_mix64(static_cast<uint64_t>(std::hash<K>{}(key)));
+    }
+};
+
+template <typename K, typename V, typename HashFn = Hash<K>, typename Eq = std::equal_to<K>>
+class HashMap
+{
+    static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                  "HashMap keeps its slots in the C engine's calloc'd array, so K and V must be trivially copyable");
+
+    static uint64_t hash_key(const K &key)
+    {
+        return HashFn{}(key);
+    }
+
+    static bool key_equals(const K &a, const K &b)
+    {
+        return Eq{}(a, b);
+    }
+
+    // engine_t, engine_slot_t and the static engine_* functions
+    HASH_TABLE_DEFINE(engine, K, V, hash_key, key_equals)
+
+public:
+    // throws std::bad_alloc if the slots can't be allocated
+    explicit HashMap(std::size_t capacity = 0) : table_()
+    {
+        reserve(capacity);
+    }
+
+    HashMap(const HashMap &other) : table_()
+    {
+        *this = other;
+    }
+
+    HashMap(HashMap &&other) noexcept : table_(other.table_)
+    {
+        other.table_ = engine_t();
+    }
+
+    HashMap &operator=(const HashMap &other)
+    {
+        if (this == &other)
+            return *this;
+
+        engine_slot_t *slots = nullptr;
+        if (other.table_.capacity)
+        {
+            slots = static_cast<engine_slot_t *>(std::malloc(other.table_.capacity * sizeof(engine_slot_t)));
+            if (!slots)
+                throw std::bad_alloc();
+            std::memcpy(slots, other.table_.slots, other.table_.capacity * sizeof(engine_slot_t));
+        }
+
+        engine_destroy(&table_);
+        table_ = other.table_;
+        table_.slots = slots;
+        return *this;
+    }
+
+    HashMap &operator=(HashMap &&other) noexcept
+    {
+        if (this != &other)
+        {
+            engine_destroy(&table_);
+            table_ = other.table_;
+            other.table_ = engine_t();
+        }
+        return *this;
+    }
+
+    ~HashMap()
+    {
+        engine_destroy(&table_);
+    }
+
+    std::size_t size() const
+    {
+        return engine_size(&table_);
+    }
+
+    void clear()
+    {
+        engine_clear(&table_);
+    }
+
+    // makes room for capacity entries without further growth; throws std::bad_alloc on failure
+    void reserve(std::size_t capacity)
+    {
+        if (!engine_reserve(&table_, capacity))
+            throw std::bad_alloc();
+    }
+
+    V *get(const K &key)
+    {
+        return engine_get(&table_, key);
+    }
+
+    const V *get(const K &key) const
+    {
+        return engine_get(&table_, key);
+    }
+
+    bool search(const K &key, V &value) const
+    {
+        return engine_search(&table_, key, &value);
+    }
+
+    // overwrites the value of an existing key; throws std::bad_alloc if the table could not grow
+    void insert(const K &key, const V &value)
+    {
+        if (!engine_insert(&table_, key, value))
+            throw std::bad_alloc();
+    }
+
+    bool remove(const K &key)
+    {
+        return engine_remove(&table_, key);
+    }
+
+private:
+    engine_t table_;
+};
+
+} // namespace hash_table
+
+#endif
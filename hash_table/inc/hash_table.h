@@ -6,36 +6,142 @@
 #include <stdint.h>
 
 #include "../../dyn_arr/inc/dyn_arr.h"
+#include "../../hash/inc/hash.h"
 
 typedef struct node
 {
     void *key;
     void *value;
     bool is_free;
+    uint32_t key_len; // bytes of key; always key_size unless the table was created with HASH_TABLE_VAR_KEYS
+    uint64_t hash; // full hash of key; resizes redistribute by it and probes compare it before the key
     struct node *next;
 } node_t;
 
+// flags for hash_table_create_ex
+#define HASH_TABLE_INCREMENTAL_RESIZE (1U << 0) // grow by migrating a few buckets per operation instead of all at once
+#define HASH_TABLE_VAR_KEYS (1U << 1)           // keys have their own lengths; key_size becomes the inline capacity per slot
+
 typedef bool (*hash_value_add)(const void *val_one, const void *val_two, const void *result);
 
+// a slab is one large allocation carved into fixed-stride slots
+// each slot holds a node_t header followed by the key bytes and then the value bytes
+typedef struct hash_slab
+{
+    struct hash_slab *next;
+} hash_slab_t;
+
+typedef struct
+{
+    hash_slab_t *slabs;  // every slab handed out so far
+    uint8_t *cursor;     // next unused slot in the newest slab
+    size_t slots_left;   // unused slots remaining in the newest slab
+    size_t slot_count;   // total slots across all slabs
+    size_t slot_size;    // stride of one slot (node + key + value, aligned)
+    size_t key_offset;   // offset of the key bytes inside a slot
+    size_t value_offset; // offset of the value bytes inside a slot
+} hash_arena_t;
+
 typedef struct
 {
-    size_t num_of_buckets; // number of buckets you want in the hashtable
-    size_t key_size;
+    size_t num_of_buckets; // number of buckets you want in the hashtable; always a power of two
+    size_t key_size; // with HASH_TABLE_VAR_KEYS, the longest key stored inline; longer keys get their own allocation
     size_t value_size;
     node_t **buckets;   // each bucket is a linked list of nodes
     node_t *free_nodes; // list of free nodes that can be reused
     size_t num_of_nodes;
+    hash_arena_t arena; // nodes, keys and values are carved out of these slabs
+    uint32_t flags;
+    hash_fn_t hash_fn; // bucket index is hash_fn(key) & (num_of_buckets - 1)
+    uint64_t seed;
+
+    // incremental resize state; old_buckets is NULL unless a migration is in flight
+    node_t **old_buckets;      // buckets not yet migrated into buckets
+    size_t old_num_of_buckets; // size of old_buckets
+    size_t migrate_index;      // every old bucket below this index has been migrated
 
 } hash_table_t;
 
 hash_table_t *hash_table_create(size_t num_of_buckets, size_t key_size, size_t value_size); // initial number of buckets you want in the hashtable
                                                                                             // each bucket is a linked list of nodes
+hash_table_t *hash_table_create_ex(size_t num_of_buckets, size_t key_size, size_t value_size, uint32_t flags);
 void hash_table_destroy(hash_table_t *table);
 
+// swaps in another hash function (HASH_FN_DEFAULT is used otherwise); only allowed while the table is empty
+bool hash_table_set_hash_fn(hash_table_t *table, hash_fn_t hash_fn, uint64_t seed);
+
+// slab allocator behind hash_table_t, shared with the other chained tables
+void hash_arena_init(hash_arena_t *arena, size_t key_size, size_t value_size);
+node_t *hash_arena_alloc(hash_arena_t *arena); // returns a slot with key and value already pointing into it
+void hash_arena_free(hash_arena_t *arena);
+
 bool hash_table_insert(hash_table_t *table, const void *key, const void *value);
 bool hash_table_delete(hash_table_t *table, const void *key);
+
+// inserts value if key is missing, otherwise replaces the stored value with combiner(stored, value)
+// a NULL combiner just overwrites; either way the key is hashed and probed once
+bool hash_table_upsert(hash_table_t *table, const void *key, const void *value, hash_value_add combiner);
+
+// returns key's value slot, adding the key with a zero-filled value first if it is missing
+// *inserted (if non-NULL) reports whether the key was added; the slot can be read and written in place
+void *hash_table_find_or_insert(hash_table_t *table, const void *key, bool *inserted);
 bool hash_table_search(hash_table_t *table, const void *key, void *value);
+
+// returns a pointer to key's value inside the table instead of copying it out, or NULL if key is missing
+// values live in slab slots that never move, so the pointer stays valid across inserts and resizes
+// (full or incremental); it dangles once key is deleted, or the table is cleared or destroyed
+// inserting or upserting the same key rewrites the pointed-to bytes in place
+const void *hash_table_get_ptr(hash_table_t *table, const void *key);
 bool hash_table_clear(hash_table_t *table);
+
+// variable-length versions of the calls above; keys are hashed and compared over key_len bytes only
+// on a table without HASH_TABLE_VAR_KEYS key_len must equal key_size, and the fixed calls above
+// work on either kind of table as if key_len were key_size
+bool hash_table_insert_var(hash_table_t *table, const void *key, size_t key_len, const void *value);
+bool hash_table_delete_var(hash_table_t *table, const void *key, size_t key_len);
+bool hash_table_upsert_var(hash_table_t *table, const void *key, size_t key_len, const void *value, hash_value_add combiner);
+void *hash_table_find_or_insert_var(hash_table_t *table, const void *key, size_t key_len, bool *inserted);
+bool hash_table_search_var(hash_table_t *table, const void *key, size_t key_len, void *value);
+const void *hash_table_get_ptr_var(hash_table_t *table, const void *key, size_t key_len);
+
+// walks every entry in bucket order; no other call on the table may come between iter_init and the last iter_next
+// (lookups drive an incremental resize too), but the value may be rewritten in place through the returned pointer
+typedef struct
+{
+    hash_table_t *table;
+    size_t bucket; // next bucket to enter; the old buckets of a resize in flight count on after the current ones
+    node_t *node;  // next node of the current chain
+} hash_table_iter_t;
+
+void hash_table_iter_init(hash_table_iter_t *iter, hash_table_t *table);
+bool hash_table_iter_next(hash_table_iter_t *iter, const void **key, size_t *key_len, void **value); // false once done
+
+// resumable scan in the style of redis SCAN: start with cursor 0, feed each returned cursor back in,
+// and stop when it comes back 0; each call visits whole buckets until at least count entries were seen
+// the table may be written to and resized (even incrementally) between calls, and every key present for
+// the whole scan is still visited at least once; keys may be visited twice across a resize
+// the cursor is a plain integer, so it can be stored and the scan resumed later
+// visit must not call back into the table
+typedef void (*hash_table_scan_fn)(const void *key, size_t key_len, void *value, void *ctx);
+uint64_t hash_table_scan(hash_table_t *table, uint64_t cursor, size_t count, hash_table_scan_fn visit, void *ctx);
+
+// writes every entry to path as a snapshot (see snapshot.h): a flat, pointer-free robin hood table that
+// snapshot_open maps read-only and searches in place, with no rebuild at load time
+// entries keep their stored hashes, so saving never rehashes a key; the table itself is left untouched
+bool hash_table_save(hash_table_t *table, const char *path);
+
+// batched versions of search and insert for large tables: keys and values are packed arrays of count entries
+// the memory accesses of neighbouring keys are overlapped with software prefetches
+// search_batch copies each hit into its slot of values, records hits in found (if non-NULL) and returns the hit count
+size_t hash_table_search_batch(hash_table_t *table, const void *keys, size_t count, void *values, bool *found);
+bool hash_table_insert_batch(hash_table_t *table, const void *keys, const void *values, size_t count); // false if any insert failed
+// merges require every input to agree on HASH_TABLE_VAR_KEYS; the output takes the same mode
+// duplicates are combined with add_value in input-table order; a NULL add_value keeps the last table's value
 hash_table_t *hash_table_merge(hash_table_t **hash_table_arr, size_t len, hash_value_add add_value, size_t key_size, size_t value_size, size_t new_bucket_num);
 
+// same result as hash_table_merge, built by num_of_threads threads (0 means one per online core)
+// the output is pre-sized from the summed input counts and its buckets are split into disjoint ranges,
+// one per thread, so no locks are taken; add_value still combines duplicates in input-table order
+hash_table_t *hash_table_merge_parallel(hash_table_t **hash_table_arr, size_t len, hash_value_add add_value, size_t key_size, size_t value_size, size_t new_bucket_num, size_t num_of_threads);
+
 #endif
\ No newline at end of file
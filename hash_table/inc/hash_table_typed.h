@@ -0,0 +1,235 @@
+#ifndef HASH_TABLE_TYPED_H
+#define HASH_TABLE_TYPED_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// type-specialized hash tables generated at compile time
+//
+// HASH_TABLE_DEFINE(name, K, V, hash, eq) emits name_t and static inline name_* functions for keys of type K
+// and values of type V; hash(K) must return a well-mixed uint64_t and eq(K, K) a bool, and both may be macros
+// keys and values are stored by value in one flat array of {key, value, probe length} slots, probed robin hood
+// style like map_t (whose slots are a hash/length header followed by raw key and value bytes), so lookups on
+// integer keys compile down to register compares with no memcmp or memcpy
+// hash_map.hpp expands this macro inside a C++ class template, so both share this one implementation
+// K and V are copied with plain assignment and memset, so in C++ they have to be trivially copyable
+
+#define HASH_TABLE_TYPED_MIN_CAPACITY (16U)
+#define HASH_TABLE_TYPED_LOAD_FACTOR (0.8)
+
+// murmur3's 64-bit finalizer; enough mixing to make the low bits of an integer key usable as a slot index
+static inline uint64_t hash_table_mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+#define HASH_TABLE_HASH_INT(key) (hash_table_mix64((uint64_t)(key)))
+#define HASH_TABLE_EQ(a, b) ((a) == (b))
+
+// name_t is a value type: zero it or call name_init, and call name_destroy when done
+// name_get's pointer is only good until the next insert or remove, which move slots
+#define HASH_TABLE_DEFINE(name, K, V, hash, eq)                                                     \
+    typedef struct                                                                                  \
+    {                                                                                               \
+        K key;                                                                                      \
+        V value;                                                                                    \
+        uint32_t psl; /* probe length + 1; 0 marks an empty slot, so a zeroed array is empty */     \
+    } name##_slot_t;                                                                                \
+                                                                                                    \
+    typedef struct                                                                                  \
+    {                                                                                               \
+        name##_slot_t *slots;                                                                       \
+        size_t capacity; /* always a power of two, or 0 before the first insert */                  \
+        size_t size;                                                                                \
+    } name##_t;                                                                                     \
+                                                                                                    \
+    static inline bool name##_init(name##_t *table, size_t capacity)                                \
+    {                                                                                               \
+        size_t cap = HASH_TABLE_TYPED_MIN_CAPACITY;                                                 \
+        while (cap * HASH_TABLE_TYPED_LOAD_FACTOR < capacity)                                       \
+            cap <<= 1;                                                                              \
+                                                                                                    \
+        table->slots = (name##_slot_t *)calloc(cap, sizeof(name##_slot_t));                         \
+        table->capacity = table->slots ? cap : 0;                                                   \
+        table->size = 0;                                                                            \
+        return table->slots != NULL;                                                                \
+    }                                                                                               \
+                                                                                                    \
+    static inline void name##_destroy(name##_t *table)                                              \
+    {                                                                                               \
+        free(table->slots);                                                                         \
+        table->slots = NULL;                                                                        \
+        table->capacity = 0;                                                                        \
+        table->size = 0;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    static inline size_t name##_size(const name##_t *table)                                         \
+    {                                                                                               \
+        return table->size;                                                                         \
+    }                                                                                               \
+                                                                                                    \
+    static inline void name##_clear(name##_t *table)                                                \
+    {                                                                                               \
+        if (table->slots)                                                                           \
+            memset(table->slots, 0, table->capacity * sizeof(name##_slot_t));                       \
+        table->size = 0;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    /* robin hood lookup: stop at the first slot whose entry is closer to home than the probe */    \
+    /* returns the slot holding key, or capacity if there is none */                                \
+    static inline size_t name##_find(const name##_t *table, K key)                                  \
+    {                                                                                               \
+        if (!table->size)                                                                           \
+            return table->capacity;                                                                 \
+                                                                                                    \
+        size_t mask = table->capacity - 1;                                                          \
+        size_t index = (size_t)(hash(key)) & mask;                                                  \
+                                                                                                    \
+        for (uint32_t psl = 1;; psl++)                                                              \
+        {                                                                                           \
+            const name##_slot_t *slot = &table->slots[index];                                       \
+            if (slot->psl < psl)                                                                    \
+                return table->capacity;                                                             \
+            if (slot->psl == psl && eq(slot->key, key))                                             \
+                return index;                                                                       \
+            index = (index + 1) & mask;                                                             \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    static inline V *name##_get(const name##_t *table, K key)                                       \
+    {                                                                                               \
+        size_t index = name##_find(table, key);                                                     \
+        return index == table->capacity ? NULL : &table->slots[index].value;                        \
+    }                                                                                               \
+                                                                                                    \
+    static inline bool name##_search(const name##_t *table, K key, V *value)                        \
+    {                                                                                               \
+        V *stored = name##_get(table, key);                                                         \
+        if (!stored)                                                                                \
+            return false;                                                                           \
+        if (value)                                                                                  \
+            *value = *stored;                                                                       \
+        return true;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    /* places a key known to be missing, swapping it past every entry closer to its home */         \
+    static inline void name##_place(name##_t *table, name##_slot_t entry)                           \
+    {                                                                                               \
+        size_t mask = table->capacity - 1;                                                          \
+        size_t index = (size_t)(hash(entry.key)) & mask;                                            \
+        entry.psl = 1;                                                                              \
+                                                                                                    \
+        for (;;)                                                                                    \
+        {                                                                                           \
+            name##_slot_t *slot = &table->slots[index];                                             \
+            if (!slot->psl)                                                                         \
+            {                                                                                       \
+                *slot = entry;                                                                      \
+                table->size++;                                                                      \
+                return;                                                                             \
+            }                                                                                       \
+            if (slot->psl < entry.psl)                                                              \
+            {                                                                                       \
+                name##_slot_t displaced = *slot;                                                    \
+                *slot = entry;                                                                      \
+                entry = displaced;                                                                  \
+            }                                                                                       \
+            entry.psl++;                                                                            \
+            index = (index + 1) & mask;                                                             \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    /* moves every entry into a new array of new_capacity slots, which must be a power of two */    \
+    static inline bool name##_rehash(name##_t *table, size_t new_capacity)                          \
+    {                                                                                               \
+        name##_slot_t *new_slots = (name##_slot_t *)calloc(new_capacity, sizeof(name##_slot_t));    \
+        if (!new_slots)                                                                             \
+            return false;                                                                           \
+                                                                                                    \
+        name##_slot_t *old_slots = table->slots;                                                    \
+        size_t old_capacity = table->capacity;                                                      \
+                                                                                                    \
+        table->slots = new_slots;                                                                   \
+        table->capacity = new_capacity;                                                             \
+        table->size = 0;                                                                            \
+                                                                                                    \
+        for (size_t index = 0; index < old_capacity; index++)                                       \
+        {                                                                                           \
+            if (old_slots[index].psl)                                                               \
+                name##_place(table, old_slots[index]);                                              \
+        }                                                                                           \
+                                                                                                    \
+        free(old_slots);                                                                            \
+        return true;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    static inline bool name##_grow(name##_t *table)                                                 \
+    {                                                                                               \
+        size_t new_capacity = table->capacity ? table->capacity * 2 : HASH_TABLE_TYPED_MIN_CAPACITY; \
+        return name##_rehash(table, new_capacity);                                                  \
+    }                                                                                               \
+                                                                                                    \
+    /* makes room for capacity entries without further growth */                                    \
+    static inline bool name##_reserve(name##_t *table, size_t capacity)                             \
+    {                                                                                               \
+        size_t cap = table->capacity ? table->capacity : HASH_TABLE_TYPED_MIN_CAPACITY;             \
+        while (cap * HASH_TABLE_TYPED_LOAD_FACTOR < capacity)                                       \
+            cap <<= 1;                                                                              \
+        return cap == table->capacity || name##_rehash(table, cap);                                 \
+    }                                                                                               \
+                                                                                                    \
+    /* overwrites the value of an existing key */                                                   \
+    static inline bool name##_insert(name##_t *table, K key, V value)                               \
+    {                                                                                               \
+        V *stored = name##_get(table, key);                                                         \
+        if (stored)                                                                                 \
+        {                                                                                           \
+            *stored = value;                                                                        \
+            return true;                                                                            \
+        }                                                                                           \
+                                                                                                    \
+        if (table->size + 1 > table->capacity * HASH_TABLE_TYPED_LOAD_FACTOR && !name##_grow(table)) \
+            return false;                                                                           \
+                                                                                                    \
+        name##_slot_t entry;                                                                        \
+        memset(&entry, 0, sizeof(entry));                                                           \
+        entry.key = key;                                                                            \
+        entry.value = value;                                                                        \
+        name##_place(table, entry);                                                                 \
+        return true;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    /* backward-shift deletion, so no tombstones are left behind */                                 \
+    static inline bool name##_remove(name##_t *table, K key)                                        \
+    {                                                                                               \
+        size_t index = name##_find(table, key);                                                     \
+        if (index == table->capacity)                                                               \
+            return false;                                                                           \
+                                                                                                    \
+        size_t mask = table->capacity - 1;                                                          \
+        size_t next = (index + 1) & mask;                                                           \
+                                                                                                    \
+        while (table->slots[next].psl > 1)                                                          \
+        {                                                                                           \
+            table->slots[index] = table->slots[next];                                               \
+            table->slots[index].psl--;                                                              \
+            index = next;                                                                           \
+            next = (next + 1) & mask;                                                               \
+        }                                                                                           \
+                                                                                                    \
+        memset(&table->slots[index], 0, sizeof(name##_slot_t));                                     \
+        table->size--;                                                                              \
+        return true;                                                                                \
+    }
+
+// integer-keyed shorthand: HASH_TABLE_DEFINE_INT(u32_map, uint32_t, uint64_t)
+#define HASH_TABLE_DEFINE_INT(name, K, V) HASH_TABLE_DEFINE(name, K, V, HASH_TABLE_HASH_INT, HASH_TABLE_EQ)
+
+#endif
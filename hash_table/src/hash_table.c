@@ -1,59 +1,176 @@
 #include "../inc/hash_table.h"
+#include "../../snapshot/inc/snapshot.h"
 
 #include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <unistd.h>
 
-#define SEED 0x9747b28c
 #define BUCKET_DOUBLING_CUTOFF (0.3)
 
-static inline uint32_t hash_murmur3_32(const void *key, size_t key_size)
+#define MIGRATE_STEP (16U)         // old buckets moved per operation during an incremental resize
+#define MIGRATE_EMPTY_VISITS (10U) // empty old buckets skipped per bucket of budget
+
+#define BATCH_GROUP (16U) // keys whose memory accesses are overlapped by the batch calls
+
+#define PREFETCH(addr) __builtin_prefetch((addr), 0, 3)
+
+#define SLAB_MIN_SLOTS (64U)       // slots in the first slab
+#define SLAB_MAX_SLOTS (1U << 16)  // slabs stop doubling once they hold this many slots
+#define SLAB_ALIGN (_Alignof(max_align_t))
+
+#define ALIGN_UP(x, a) (((x) + ((a) - 1)) & ~((size_t)(a) - 1))
+
+static inline uint64_t hash_table_hash(const hash_table_t *table, const void *key, size_t key_len)
+{
+    return table->hash_fn(key, key_len, table->seed);
+}
+
+// fixed-size tables only ever see key_size; variable-length ones take anything that fits node_t's key_len
+static inline bool hash_table_key_len_ok(const hash_table_t *table, size_t key_len)
 {
-    const uint8_t *data = (const uint8_t *)key;
-    const int nblocks = key_size / 4;
-    uint32_t h = SEED;
-    const uint32_t c1 = 0xcc9e2d51;
-    const uint32_t c2 = 0x1b873593;
+    if (table->flags & HASH_TABLE_VAR_KEYS)
+        return key_len <= UINT32_MAX;
+    return key_len == table->key_size;
+}
+
+// the key bytes inside node's own slot
+static inline void *hash_node_inline_key(const hash_arena_t *arena, node_t *node)
+{
+    return (uint8_t *)node + arena->key_offset;
+}
 
-    const uint32_t *blocks = (const uint32_t *)(data);
-    for (int i = 0; i < nblocks; i++)
+// copies key into node; keys longer than inline_cap (only possible with HASH_TABLE_VAR_KEYS) get their own allocation
+static bool hash_node_set_key(const hash_arena_t *arena, size_t inline_cap, node_t *node, const void *key, size_t key_len)
+{
+    void *dst = hash_node_inline_key(arena, node);
+    if (key_len > inline_cap)
     {
-        uint32_t k = blocks[i];
-        k *= c1;
-        k = (k << 15) | (k >> 17);
-        k *= c2;
+        dst = malloc(key_len);
+        if (!dst)
+            return false;
+    }
+
+    memcpy(dst, key, key_len);
+    node->key = dst;
+    node->key_len = (uint32_t)key_len;
+    return true;
+}
 
-        h ^= k;
-        h = (h << 13) | (h >> 19);
-        h = h * 5 + 0xe6546b64;
+// frees a spilled key and points node back at its inline bytes, ready for reuse
+static void hash_node_release_key(const hash_arena_t *arena, node_t *node)
+{
+    void *inline_key = hash_node_inline_key(arena, node);
+    if (node->key != inline_key)
+    {
+        free(node->key);
+        node->key = inline_key;
     }
+}
+
+static size_t round_up_pow2(size_t n)
+{
+    size_t pow = 1;
+    while (pow < n)
+        pow <<= 1;
+    return pow;
+}
 
-    const uint8_t *tail = (const uint8_t *)(data + nblocks * 4);
-    uint32_t k1 = 0;
-    switch (key_size & 3)
+void hash_arena_init(hash_arena_t *arena, size_t key_size, size_t value_size)
+{
+    arena->slabs = NULL;
+    arena->cursor = NULL;
+    arena->slots_left = 0;
+    arena->slot_count = 0;
+    arena->key_offset = ALIGN_UP(sizeof(node_t), SLAB_ALIGN);
+    arena->value_offset = ALIGN_UP(arena->key_offset + key_size, SLAB_ALIGN);
+    arena->slot_size = ALIGN_UP(arena->value_offset + value_size, SLAB_ALIGN);
+}
+
+void hash_arena_free(hash_arena_t *arena)
+{
+    hash_slab_t *slab = arena->slabs;
+    while (slab)
     {
-    case 3:
-        k1 ^= tail[2] << 16;
-    case 2:
-        k1 ^= tail[1] << 8;
-    case 1:
-        k1 ^= tail[0];
-        k1 *= c1;
-        k1 = (k1 << 15) | (k1 >> 17);
-        k1 *= c2;
-        h ^= k1;
+        hash_slab_t *next = slab->next;
+        free(slab);
+        slab = next;
     }
 
-    h ^= key_size;
-    h ^= h >> 16;
-    h *= 0x85ebca6b;
-    h ^= h >> 13;
-    h *= 0xc2b2ae35;
-    h ^= h >> 16;
+    arena->slabs = NULL;
+    arena->cursor = NULL;
+    arena->slots_left = 0;
+    arena->slot_count = 0;
+}
 
-    return h;
+// moves every slab of src into dst; src is left empty
+// dst keeps its own bump cursor so the adopted slabs are only reused through the free list
+static void hash_arena_adopt(hash_arena_t *dst, hash_arena_t *src)
+{
+    hash_slab_t *slab = src->slabs;
+    while (slab)
+    {
+        hash_slab_t *next = slab->next;
+        slab->next = dst->slabs;
+        dst->slabs = slab;
+        slab = next;
+    }
+
+    dst->slot_count += src->slot_count;
+
+    src->slabs = NULL;
+    src->cursor = NULL;
+    src->slots_left = 0;
+    src->slot_count = 0;
+}
+
+// hands out a fresh slot with its key and value pointers wired up
+// slabs double in size (up to SLAB_MAX_SLOTS) so the number of slabs stays logarithmic
+node_t *hash_arena_alloc(hash_arena_t *arena)
+{
+    if (!arena->slots_left)
+    {
+        size_t slots = arena->slot_count;
+        if (slots < SLAB_MIN_SLOTS)
+            slots = SLAB_MIN_SLOTS;
+        if (slots > SLAB_MAX_SLOTS)
+            slots = SLAB_MAX_SLOTS;
+
+        size_t header = ALIGN_UP(sizeof(hash_slab_t), SLAB_ALIGN);
+        hash_slab_t *slab = malloc(header + slots * arena->slot_size);
+        if (!slab)
+            return NULL;
+
+        slab->next = arena->slabs;
+        arena->slabs = slab;
+        arena->cursor = (uint8_t *)slab + header;
+        arena->slots_left = slots;
+        arena->slot_count += slots;
+    }
+
+    node_t *node = (node_t *)arena->cursor;
+    node->key = arena->cursor + arena->key_offset;
+    node->value = arena->cursor + arena->value_offset;
+
+    arena->cursor += arena->slot_size;
+    arena->slots_left--;
+
+    return node;
 }
 
 hash_table_t *hash_table_create(size_t num_of_buckets, size_t key_size, size_t value_size)
 {
+    return hash_table_create_ex(num_of_buckets, key_size, value_size, 0);
+}
+
+hash_table_t *hash_table_create_ex(size_t num_of_buckets, size_t key_size, size_t value_size, uint32_t flags)
+{
+    if (!num_of_buckets)
+        return NULL;
+
+    // power-of-two bucket counts let every operation mask the hash instead of dividing
+    num_of_buckets = round_up_pow2(num_of_buckets);
+
     hash_table_t *table = malloc(sizeof(hash_table_t));
     if (!table)
         return NULL;
@@ -70,6 +187,13 @@ hash_table_t *hash_table_create(size_t num_of_buckets, size_t key_size, size_t v
     table->key_size = key_size;
     table->free_nodes = NULL;
     table->num_of_nodes = 0;
+    hash_arena_init(&table->arena, key_size, value_size);
+    table->flags = flags;
+    table->hash_fn = HASH_FN_DEFAULT;
+    table->seed = HASH_DEFAULT_SEED;
+    table->old_buckets = NULL;
+    table->old_num_of_buckets = 0;
+    table->migrate_index = 0;
 
     return table;
 }
@@ -79,33 +203,38 @@ void hash_table_destroy(hash_table_t *table)
     if (!table)
         return;
 
-    for (size_t i = 0; i < table->num_of_buckets; i++)
+    // every node (live or free) lives inside a slab, so only spilled keys need a walk of the chains
+    if (table->flags & HASH_TABLE_VAR_KEYS)
     {
-        node_t *current = table->buckets[i];
-        while (current)
+        size_t total_buckets = table->num_of_buckets + table->old_num_of_buckets;
+        for (size_t counter = 0; counter < total_buckets; counter++)
         {
-            node_t *next = current->next;
-            free(current->key);
-            free(current->value);
-            free(current);
-            current = next;
+            node_t *curr = counter < table->num_of_buckets ? table->buckets[counter]
+                                                           : table->old_buckets[counter - table->num_of_buckets];
+            for (; curr; curr = curr->next)
+            {
+                hash_node_release_key(&table->arena, curr);
+            }
         }
     }
 
-    node_t *current = table->free_nodes;
-    while (current)
-    {
-        node_t *next = current->next;
-        free(current->key);
-        free(current->value);
-        free(current);
-        current = next;
-    }
+    hash_arena_free(&table->arena);
 
+    free(table->old_buckets);
     free(table->buckets);
     free(table);
 }
 
+bool hash_table_set_hash_fn(hash_table_t *table, hash_fn_t hash_fn, uint64_t seed)
+{
+    if (!table || !hash_fn || table->num_of_nodes)
+        return false;
+
+    table->hash_fn = hash_fn;
+    table->seed = seed;
+    return true;
+}
+
 hash_table_t *hash_table_merge(hash_table_t **hash_table_arr, size_t len, hash_value_add add_value, size_t key_size, size_t value_size, size_t new_bucket_num)
 {
     if (!hash_table_arr)
@@ -113,90 +242,498 @@ hash_table_t *hash_table_merge(hash_table_t **hash_table_arr, size_t len, hash_v
         return NULL;
     }
 
+    uint32_t var_keys = len && hash_table_arr[0] ? hash_table_arr[0]->flags & HASH_TABLE_VAR_KEYS : 0;
     for (size_t index = 0; index < len; index++)
     {
         hash_table_t *table = hash_table_arr[index];
-        if (!table || (table->key_size != key_size) || (table->value_size != value_size))
+        if (!table || (table->key_size != key_size) || (table->value_size != value_size) ||
+            (table->flags & HASH_TABLE_VAR_KEYS) != var_keys)
         {
             return NULL;
         }
     }
 
-    hash_table_t *merged_table = hash_table_create(new_bucket_num, key_size, value_size);
+    hash_table_t *merged_table = hash_table_create_ex(new_bucket_num, key_size, value_size, var_keys);
     if (!merged_table)
     {
         return NULL;
     }
 
-    uint8_t *value = (uint8_t *)malloc(value_size);
-    if (!value)
+    // the merged table hashes like its first input
+    if (len)
+        hash_table_set_hash_fn(merged_table, hash_table_arr[0]->hash_fn, hash_table_arr[0]->seed);
+
+    for (size_t index = 0; index < len; index++)
     {
-        hash_table_destroy(merged_table);
-        return NULL;
+        hash_table_t *table = hash_table_arr[index];
+
+        // a table in the middle of an incremental resize keeps part of its entries in old_buckets
+        size_t total_buckets = table->num_of_buckets + table->old_num_of_buckets;
+        for (size_t counter = 0; counter < total_buckets; counter++)
+        {
+            node_t *curr = counter < table->num_of_buckets ? table->buckets[counter]
+                                                           : table->old_buckets[counter - table->num_of_buckets];
+            while (curr)
+            {
+                // one hash and one probe per entry; duplicates go through add_value
+                if (!curr->is_free && !hash_table_upsert_var(merged_table, curr->key, curr->key_len, curr->value, add_value))
+                {
+                    hash_table_destroy(merged_table);
+                    return NULL;
+                }
+                curr = curr->next;
+            }
+        }
     }
 
-    uint8_t *new_val = (uint8_t *)malloc(value_size);
+    return merged_table;
+}
+
+typedef struct
+{
+    node_t *node;
+    uint64_t hash;
+} merge_entry_t;
+
+typedef struct
+{
+    merge_entry_t *entries;
+    size_t len;
+    size_t cap;
+} merge_run_t;
+
+typedef struct merge_worker
+{
+    hash_table_t **hash_table_arr;
+    size_t first_table; // phase one: tables [first_table, last_table) are hashed by this worker
+    size_t last_table;
+    size_t num_of_threads;
+    hash_value_add add_value;
+    hash_table_t *merged_table;
+    struct merge_worker *all_workers;
+
+    // runs[p] holds this worker's entries that fall into partition p, in input order
+    merge_run_t *runs;
+
+    // phase two: this worker alone fills the output buckets that fall into this partition
+    size_t partition;
+    hash_arena_t arena; // private slabs, handed to merged_table once the worker is done
+    size_t num_of_nodes;
+
+    bool failed;
+} merge_worker_t;
+
+// partitions are contiguous bucket ranges of the output table
+static size_t merge_partition_of(size_t bucket, size_t num_of_buckets, size_t num_of_partitions)
+{
+    return bucket * num_of_partitions / num_of_buckets;
+}
+
+static bool merge_run_push(merge_run_t *run, node_t *node, uint64_t hash)
+{
+    if (run->len == run->cap)
+    {
+        size_t new_cap = run->cap ? run->cap * 2 : 256;
+        merge_entry_t *entries = realloc(run->entries, new_cap * sizeof(merge_entry_t));
+        if (!entries)
+            return false;
+
+        run->entries = entries;
+        run->cap = new_cap;
+    }
+
+    run->entries[run->len].node = node;
+    run->entries[run->len].hash = hash;
+    run->len++;
+    return true;
+}
+
+// phase one: hash every live entry of this worker's input tables once and scatter it by partition
+static void *merge_scatter(void *arg)
+{
+    merge_worker_t *worker = (merge_worker_t *)arg;
+    size_t num_of_buckets = worker->merged_table->num_of_buckets;
+
+    for (size_t index = worker->first_table; index < worker->last_table; index++)
+    {
+        hash_table_t *table = worker->hash_table_arr[index];
+
+        // stored hashes can be reused only if the input hashes the same way as the output
+        bool same_hash = table->hash_fn == worker->merged_table->hash_fn && table->seed == worker->merged_table->seed;
+
+        size_t total_buckets = table->num_of_buckets + table->old_num_of_buckets;
+        for (size_t counter = 0; counter < total_buckets; counter++)
+        {
+            node_t *curr = counter < table->num_of_buckets ? table->buckets[counter]
+                                                           : table->old_buckets[counter - table->num_of_buckets];
+            for (; curr; curr = curr->next)
+            {
+                if (curr->is_free)
+                    continue;
+
+                uint64_t hash = same_hash ? curr->hash : hash_table_hash(worker->merged_table, curr->key, curr->key_len);
+                size_t partition = merge_partition_of(hash & (num_of_buckets - 1), num_of_buckets, worker->num_of_threads);
+
+                if (!merge_run_push(&worker->runs[partition], curr, hash))
+                {
+                    worker->failed = true;
+                    return NULL;
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// phase two: apply every run aimed at this worker's partition, in worker (and so input-table) order
+static void *merge_gather(void *arg)
+{
+    merge_worker_t *worker = (merge_worker_t *)arg;
+    hash_table_t *merged_table = worker->merged_table;
+    size_t key_size = merged_table->key_size;
+    size_t value_size = merged_table->value_size;
+
+    // heap scratch, as value_size is the caller's and may be too big (or 0, an invalid VLA) for the stack
+    uint8_t *new_val = malloc(value_size ? value_size : 1);
     if (!new_val)
     {
-        free(value);
-        hash_table_destroy(merged_table);
+        worker->failed = true;
         return NULL;
     }
 
-    for (size_t index = 0; index < len; index++)
+    for (size_t source = 0; source < worker->num_of_threads; source++)
     {
-        hash_table_t *table = hash_table_arr[index];
-        for (size_t counter = 0; counter < table->num_of_buckets; counter++)
+        merge_run_t *run = &worker->all_workers[source].runs[worker->partition];
+
+        for (size_t index = 0; index < run->len; index++)
         {
-            node_t *curr = table->buckets[counter];
-            while (curr)
+            node_t *curr = run->entries[index].node;
+            uint64_t hash = run->entries[index].hash;
+            node_t **bucket = &merged_table->buckets[hash & (merged_table->num_of_buckets - 1)];
+
+            node_t *found = *bucket;
+            while (found && (found->hash != hash || found->key_len != curr->key_len || memcmp(found->key, curr->key, curr->key_len)))
             {
-                if (!curr->is_free)
+                found = found->next;
+            }
+
+            if (found)
+            {
+                // with no add_value the later table's value wins, as hash_table_upsert does
+                if (!worker->add_value)
                 {
-                    if (!hash_table_search(merged_table, curr->key, (void *)value))
-                    {
-                        if (!hash_table_insert(merged_table, curr->key, curr->value))
-                        {
-                            free(value);
-                            free(new_val);
-                            hash_table_destroy(merged_table);
-                            return NULL;
-                        }
-                    }
-                    else
-                    {
-                        if (!add_value((void *)value, curr->value, (void *)new_val))
-                        {
-                            free(value);
-                            free(new_val);
-                            hash_table_destroy(merged_table);
-                            return NULL;
-                        }
-
-                        if (!hash_table_insert(merged_table, curr->key, new_val))
-                        {
-                            free(value);
-                            free(new_val);
-                            hash_table_destroy(merged_table);
-                            return NULL;
-                        }
-                    }
+                    memcpy(found->value, curr->value, value_size);
+                    continue;
                 }
-                curr = curr->next;
+
+                if (!worker->add_value(found->value, curr->value, new_val))
+                {
+                    worker->failed = true;
+                    free(new_val);
+                    return NULL;
+                }
+                memcpy(found->value, new_val, value_size);
+                continue;
+            }
+
+            node_t *new_node = hash_arena_alloc(&worker->arena);
+            if (!new_node || !hash_node_set_key(&worker->arena, key_size, new_node, curr->key, curr->key_len))
+            {
+                worker->failed = true;
+                free(new_val);
+                return NULL;
             }
+
+            memcpy(new_node->value, curr->value, value_size);
+            new_node->is_free = false;
+            new_node->hash = hash;
+            new_node->next = *bucket;
+            *bucket = new_node;
+
+            worker->num_of_nodes++;
         }
     }
 
-    free(value);
     free(new_val);
+    return NULL;
+}
+
+// runs fn on every worker, one thread each; the calling thread takes worker 0
+static bool merge_run_workers(merge_worker_t *workers, size_t num_of_threads, void *(*fn)(void *))
+{
+    pthread_t *threads = calloc(num_of_threads, sizeof(pthread_t));
+    if (!threads)
+        return false;
+
+    size_t started = 1;
+    bool ok = true;
+
+    for (; started < num_of_threads; started++)
+    {
+        if (pthread_create(&threads[started], NULL, fn, &workers[started]))
+        {
+            ok = false;
+            break;
+        }
+    }
+
+    fn(&workers[0]);
+
+    for (size_t index = 1; index < started; index++)
+    {
+        pthread_join(threads[index], NULL);
+    }
+    free(threads);
+
+    for (size_t index = 0; index < num_of_threads; index++)
+    {
+        if (workers[index].failed)
+            ok = false;
+    }
+
+    return ok;
+}
+
+hash_table_t *hash_table_merge_parallel(hash_table_t **hash_table_arr, size_t len, hash_value_add add_value, size_t key_size, size_t value_size, size_t new_bucket_num, size_t num_of_threads)
+{
+    if (!hash_table_arr)
+    {
+        return NULL;
+    }
+
+    size_t total_nodes = 0;
+    uint32_t var_keys = len && hash_table_arr[0] ? hash_table_arr[0]->flags & HASH_TABLE_VAR_KEYS : 0;
+    for (size_t index = 0; index < len; index++)
+    {
+        hash_table_t *table = hash_table_arr[index];
+        if (!table || (table->key_size != key_size) || (table->value_size != value_size) ||
+            (table->flags & HASH_TABLE_VAR_KEYS) != var_keys)
+        {
+            return NULL;
+        }
+        total_nodes += table->num_of_nodes;
+    }
+
+    if (!num_of_threads)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        num_of_threads = cores > 0 ? (size_t)cores : 1;
+    }
+
+    // size the output so the merge never crosses the doubling cutoff; workers can't resize a shared table
+    size_t min_buckets = (size_t)(total_nodes / BUCKET_DOUBLING_CUTOFF) + 1;
+    if (new_bucket_num < min_buckets)
+        new_bucket_num = min_buckets;
+    if (num_of_threads > new_bucket_num)
+        num_of_threads = new_bucket_num;
+
+    hash_table_t *merged_table = hash_table_create_ex(new_bucket_num, key_size, value_size, var_keys);
+    if (!merged_table)
+    {
+        return NULL;
+    }
+
+    if (len)
+        hash_table_set_hash_fn(merged_table, hash_table_arr[0]->hash_fn, hash_table_arr[0]->seed);
+
+    merge_worker_t *workers = calloc(num_of_threads, sizeof(merge_worker_t));
+    if (!workers)
+    {
+        hash_table_destroy(merged_table);
+        return NULL;
+    }
+
+    bool ok = true;
+    for (size_t index = 0; index < num_of_threads; index++)
+    {
+        merge_worker_t *worker = &workers[index];
+
+        worker->hash_table_arr = hash_table_arr;
+        worker->first_table = len * index / num_of_threads;
+        worker->last_table = len * (index + 1) / num_of_threads;
+        worker->num_of_threads = num_of_threads;
+        worker->add_value = add_value;
+        worker->merged_table = merged_table;
+        worker->all_workers = workers;
+
+        worker->partition = index;
+        hash_arena_init(&worker->arena, key_size, value_size);
+
+        worker->runs = calloc(num_of_threads, sizeof(merge_run_t));
+        if (!worker->runs)
+            ok = false;
+    }
+
+    if (ok)
+        ok = merge_run_workers(workers, num_of_threads, merge_scatter);
+    if (ok)
+        ok = merge_run_workers(workers, num_of_threads, merge_gather);
+
+    for (size_t index = 0; index < num_of_threads; index++)
+    {
+        merge_worker_t *worker = &workers[index];
+
+        // the nodes linked into merged_table live in the worker's slabs, so the table takes them over
+        hash_arena_adopt(&merged_table->arena, &worker->arena);
+        merged_table->num_of_nodes += worker->num_of_nodes;
+
+        if (worker->runs)
+        {
+            for (size_t partition = 0; partition < num_of_threads; partition++)
+            {
+                free(worker->runs[partition].entries);
+            }
+            free(worker->runs);
+        }
+    }
+
+    free(workers);
+
+    if (!ok)
+    {
+        hash_table_destroy(merged_table);
+        return NULL;
+    }
+
     return merged_table;
 }
 
+// moves one old bucket chain into the new bucket array
+static void hash_table_migrate_bucket(hash_table_t *table, size_t old_index)
+{
+    node_t *current = table->old_buckets[old_index];
+    while (current)
+    {
+        node_t *next = current->next;
+
+        if (!current->is_free)
+        {
+            unsigned long new_hash = current->hash & (table->num_of_buckets - 1);
+            current->next = table->buckets[new_hash];
+            table->buckets[new_hash] = current;
+        }
+        else
+        {
+            current->next = table->free_nodes;
+            table->free_nodes = current;
+        }
+
+        current = next;
+    }
+
+    table->old_buckets[old_index] = NULL;
+}
+
+static void hash_table_end_migration(hash_table_t *table)
+{
+    free(table->old_buckets);
+    table->old_buckets = NULL;
+    table->old_num_of_buckets = 0;
+    table->migrate_index = 0;
+}
+
+// migrates at most `steps` non-empty old buckets, so the work done per operation stays bounded
+// regardless of table size; empty buckets are skipped but also capped
+static void hash_table_migrate(hash_table_t *table, size_t steps)
+{
+    if (!table->old_buckets)
+        return;
+
+    size_t empty_visits = steps * MIGRATE_EMPTY_VISITS;
+
+    while (steps && table->migrate_index < table->old_num_of_buckets)
+    {
+        if (!table->old_buckets[table->migrate_index])
+        {
+            table->migrate_index++;
+            if (!--empty_visits)
+                break;
+            continue;
+        }
+
+        hash_table_migrate_bucket(table, table->migrate_index++);
+        steps--;
+    }
+
+    if (table->migrate_index >= table->old_num_of_buckets)
+        hash_table_end_migration(table);
+}
+
+// swaps in a larger bucket array and leaves the old one to be drained by hash_table_migrate
+static bool hash_table_begin_migration(hash_table_t *table, size_t new_bucket_count)
+{
+    node_t **new_buckets = calloc(new_bucket_count, sizeof(node_t *));
+    if (!new_buckets)
+        return false;
+
+    table->old_buckets = table->buckets;
+    table->old_num_of_buckets = table->num_of_buckets;
+    table->migrate_index = 0;
+
+    table->buckets = new_buckets;
+    table->num_of_buckets = new_bucket_count;
+
+    return true;
+}
+
+// finds the node holding key, looking in the old bucket array too while a migration is in flight
+// if link is non-NULL it receives the pointer that points at the found node, for unlinking
+static node_t *hash_table_find(hash_table_t *table, const void *key, size_t key_len, uint64_t hash, node_t ***link)
+{
+    node_t **prev = &table->buckets[hash & (table->num_of_buckets - 1)];
+    node_t *current = *prev;
+
+    while (current)
+    {
+        if (!current->is_free && current->hash == hash && current->key_len == key_len && !memcmp(current->key, key, key_len))
+        {
+            if (link)
+                *link = prev;
+            return current;
+        }
+
+        prev = &current->next;
+        current = current->next;
+    }
+
+    if (!table->old_buckets)
+        return NULL;
+
+    size_t old_index = hash & (table->old_num_of_buckets - 1);
+    if (old_index < table->migrate_index)
+        return NULL; // that chain has already been migrated
+
+    prev = &table->old_buckets[old_index];
+    current = *prev;
+
+    while (current)
+    {
+        if (!current->is_free && current->hash == hash && current->key_len == key_len && !memcmp(current->key, key, key_len))
+        {
+            if (link)
+                *link = prev;
+            return current;
+        }
+
+        prev = &current->next;
+        current = current->next;
+    }
+
+    return NULL;
+}
+
 bool hash_table_resize(hash_table_t *table, size_t new_bucket_count)
 {
     if (!table || new_bucket_count <= 0)
         return false;
 
+    new_bucket_count = round_up_pow2(new_bucket_count);
+
+    // a full resize first drains any incremental migration still in flight
+    if (table->old_buckets)
+        hash_table_migrate(table, table->old_num_of_buckets);
+
     node_t **new_buckets = calloc(new_bucket_count, sizeof(node_t *));
     if (!new_buckets)
         return false;
@@ -214,8 +751,8 @@ bool hash_table_resize(hash_table_t *table, size_t new_bucket_count)
 
             if (!current->is_free)
             {
-                // calculate new hash based on new bucket count
-                unsigned long new_hash = hash_murmur3_32(current->key, table->key_size) % new_bucket_count;
+                // redistribute by the stored hash; the key itself is never rehashed
+                unsigned long new_hash = current->hash & (new_bucket_count - 1);
 
                 // insert at beginning of new bucket chain
                 current->next = new_buckets[new_hash];
@@ -240,30 +777,33 @@ bool hash_table_resize(hash_table_t *table, size_t new_bucket_count)
     return true;
 }
 
-bool hash_table_insert(hash_table_t *table, const void *key, const void *value)
+// finds key's node, or links a new node holding key (its value left unwritten) if there is none
+// hash is the key's full hash; one probe either way, and *inserted tells the caller which happened
+static node_t *hash_table_find_or_add(hash_table_t *table, const void *key, size_t key_len, uint64_t hash, bool *inserted)
 {
-    if (!table || !key || !value)
-        return false;
+    hash_table_migrate(table, MIGRATE_STEP);
 
     if (table->num_of_nodes >= BUCKET_DOUBLING_CUTOFF * table->num_of_buckets)
     {
-        if (!hash_table_resize(table, table->num_of_buckets * 2))
+        if (table->flags & HASH_TABLE_INCREMENTAL_RESIZE)
+        {
+            // only one migration runs at a time; MIGRATE_STEP keeps it far ahead of the next doubling
+            if (!table->old_buckets && !hash_table_begin_migration(table, table->num_of_buckets * 2))
+            {
+                // resizing failed will lead to a performance degrade
+            }
+        }
+        else if (!hash_table_resize(table, table->num_of_buckets * 2))
         {
             // rehashing failed will lead to a performance degrade
         }
     }
 
-    unsigned long hash = hash_murmur3_32(key, table->key_size) % table->num_of_buckets;
-
-    node_t *current = table->buckets[hash];
-    while (current)
+    node_t *current = hash_table_find(table, key, key_len, hash, NULL);
+    if (current)
     {
-        if (!current->is_free && !memcmp(current->key, key, table->key_size))
-        {
-            memcpy(current->value, value, table->value_size);
-            return true;
-        }
-        current = current->next;
+        *inserted = false;
+        return current;
     }
 
     node_t *new_node = NULL;
@@ -274,38 +814,110 @@ bool hash_table_insert(hash_table_t *table, const void *key, const void *value)
     }
     else
     {
-        new_node = malloc(sizeof(node_t));
+        // node header, key and value share one slab slot
+        new_node = hash_arena_alloc(&table->arena);
         if (!new_node)
-            return false;
-
-        new_node->key = malloc(table->key_size);
-        if (!new_node->key)
-        {
-            free(new_node);
-            return false;
-        }
-
-        new_node->value = malloc(table->value_size);
-        if (!new_node->value)
-        {
-            free(new_node->key);
-            free(new_node);
-            return false;
-        }
+            return NULL;
     }
 
-    memcpy(new_node->key, key, table->key_size);
-    memcpy(new_node->value, value, table->value_size);
+    if (!hash_node_set_key(&table->arena, table->key_size, new_node, key, key_len))
+    {
+        new_node->is_free = true;
+        new_node->next = table->free_nodes;
+        table->free_nodes = new_node;
+        return NULL;
+    }
 
-    new_node->next = table->buckets[hash];
+    // new entries always go into the new bucket array
+    unsigned long index = hash & (table->num_of_buckets - 1);
+    new_node->next = table->buckets[index];
     new_node->is_free = false;
-    table->buckets[hash] = new_node;
+    new_node->hash = hash;
+    table->buckets[index] = new_node;
 
     table->num_of_nodes++;
 
+    *inserted = true;
+    return new_node;
+}
+
+bool hash_table_insert(hash_table_t *table, const void *key, const void *value)
+{
+    return table && hash_table_insert_var(table, key, table->key_size, value);
+}
+
+bool hash_table_insert_var(hash_table_t *table, const void *key, size_t key_len, const void *value)
+{
+    if (!table || !key || !value || !hash_table_key_len_ok(table, key_len))
+        return false;
+
+    bool inserted;
+    node_t *node = hash_table_find_or_add(table, key, key_len, hash_table_hash(table, key, key_len), &inserted);
+    if (!node)
+        return false;
+
+    memcpy(node->value, value, table->value_size);
     return true;
 }
 
+void *hash_table_find_or_insert(hash_table_t *table, const void *key, bool *inserted)
+{
+    return table ? hash_table_find_or_insert_var(table, key, table->key_size, inserted) : NULL;
+}
+
+void *hash_table_find_or_insert_var(hash_table_t *table, const void *key, size_t key_len, bool *inserted)
+{
+    if (!table || !key || !hash_table_key_len_ok(table, key_len))
+        return NULL;
+
+    bool added;
+    node_t *node = hash_table_find_or_add(table, key, key_len, hash_table_hash(table, key, key_len), &added);
+    if (!node)
+        return NULL;
+
+    if (added)
+        memset(node->value, 0, table->value_size);
+
+    if (inserted)
+        *inserted = added;
+
+    return node->value;
+}
+
+bool hash_table_upsert(hash_table_t *table, const void *key, const void *value, hash_value_add combiner)
+{
+    return table && hash_table_upsert_var(table, key, table->key_size, value, combiner);
+}
+
+bool hash_table_upsert_var(hash_table_t *table, const void *key, size_t key_len, const void *value, hash_value_add combiner)
+{
+    if (!table || !key || !value || !hash_table_key_len_ok(table, key_len))
+        return false;
+
+    bool inserted;
+    node_t *node = hash_table_find_or_add(table, key, key_len, hash_table_hash(table, key, key_len), &inserted);
+    if (!node)
+        return false;
+
+    if (inserted || !combiner)
+    {
+        memcpy(node->value, value, table->value_size);
+        return true;
+    }
+
+    // the combiner writes into a scratch copy so it never sees its output aliasing an input
+    uint8_t *new_val = malloc(table->value_size ? table->value_size : 1);
+    if (!new_val)
+        return false;
+
+    bool combined = combiner(node->value, value, new_val);
+    if (combined)
+        memcpy(node->value, new_val, table->value_size);
+
+    free(new_val);
+    return combined;
+}
+
 // marks all the entries in the table as free
 bool hash_table_clear(hash_table_t *table)
 {
@@ -314,6 +926,28 @@ bool hash_table_clear(hash_table_t *table)
         return false;
     }
 
+    // drop any migration in flight; its chains are released below along with the rest
+    if (table->old_buckets)
+    {
+        for (size_t index = table->migrate_index; index < table->old_num_of_buckets; index++)
+        {
+            node_t *curr = table->old_buckets[index];
+            while (curr)
+            {
+                node_t *next = curr->next;
+
+                hash_node_release_key(&table->arena, curr);
+                curr->is_free = true;
+                curr->next = table->free_nodes;
+                table->free_nodes = curr;
+
+                curr = next;
+            }
+        }
+
+        hash_table_end_migration(table);
+    }
+
     for (size_t index = 0; index < table->num_of_buckets; index++)
     {
         node_t *curr = table->buckets[index];
@@ -323,6 +957,7 @@ bool hash_table_clear(hash_table_t *table)
 
             if (!curr->is_free)
             {
+                hash_node_release_key(&table->arena, curr);
                 curr->is_free = true;
                 curr->next = table->free_nodes;
                 table->free_nodes = curr;
@@ -341,60 +976,341 @@ bool hash_table_clear(hash_table_t *table)
 // this is better since we can use the space allocated for some other entry
 bool hash_table_delete(hash_table_t *table, const void *key)
 {
-    if (!table || !key)
+    return table && hash_table_delete_var(table, key, table->key_size);
+}
+
+bool hash_table_delete_var(hash_table_t *table, const void *key, size_t key_len)
+{
+    if (!table || !key || !hash_table_key_len_ok(table, key_len))
         return false;
 
-    unsigned long hash = hash_murmur3_32(key, table->key_size) % table->num_of_buckets;
+    hash_table_migrate(table, MIGRATE_STEP);
+
+    node_t **link = NULL;
+    node_t *current = hash_table_find(table, key, key_len, hash_table_hash(table, key, key_len), &link);
+    if (!current)
+        return false;
 
-    node_t *current = table->buckets[hash];
-    node_t *prev = NULL;
+    *link = current->next;
 
-    while (current)
+    hash_node_release_key(&table->arena, current);
+    current->is_free = true;
+    current->next = table->free_nodes;
+    table->free_nodes = current;
+
+    table->num_of_nodes--;
+
+    return true;
+}
+
+bool hash_table_search(hash_table_t *table, const void *key, void *value)
+{
+    return table && hash_table_search_var(table, key, table->key_size, value);
+}
+
+bool hash_table_search_var(hash_table_t *table, const void *key, size_t key_len, void *value)
+{
+    if (!table || !key || !value)
+        return false;
+
+    const void *stored = hash_table_get_ptr_var(table, key, key_len);
+    if (!stored)
+        return false;
+
+    memcpy(value, stored, table->value_size);
+    return true;
+}
+
+const void *hash_table_get_ptr(hash_table_t *table, const void *key)
+{
+    return table ? hash_table_get_ptr_var(table, key, table->key_size) : NULL;
+}
+
+const void *hash_table_get_ptr_var(hash_table_t *table, const void *key, size_t key_len)
+{
+    if (!table || !key || !hash_table_key_len_ok(table, key_len))
+        return NULL;
+
+    hash_table_migrate(table, MIGRATE_STEP);
+
+    node_t *current = hash_table_find(table, key, key_len, hash_table_hash(table, key, key_len), NULL);
+    if (!current)
+        return NULL;
+
+    return current->value;
+}
+
+// group prefetching: hash a whole group first and prefetch every bucket head, then prefetch every
+// first node, and only then walk the chains, so the cache misses of the group overlap instead of queueing
+size_t hash_table_search_batch(hash_table_t *table, const void *keys, size_t count, void *values, bool *found)
+{
+    if (!table || !keys || !values)
+        return 0;
+
+    const uint8_t *key_bytes = (const uint8_t *)keys;
+    uint8_t *value_bytes = (uint8_t *)values;
+    size_t hits = 0;
+
+    uint64_t hashes[BATCH_GROUP];
+    node_t *heads[BATCH_GROUP];
+
+    for (size_t start = 0; start < count; start += BATCH_GROUP)
     {
-        if (!current->is_free && !memcmp(current->key, key, table->key_size))
+        size_t len = count - start < BATCH_GROUP ? count - start : BATCH_GROUP;
+
+        hash_table_migrate(table, MIGRATE_STEP);
+
+        if (table->old_buckets)
         {
-            if (prev)
+            // chains may still be split across two arrays; take the plain path until the migration is done
+            for (size_t i = start; i < start + len; i++)
             {
-                prev->next = current->next;
+                bool hit = hash_table_search(table, key_bytes + i * table->key_size, value_bytes + i * table->value_size);
+                hits += hit;
+                if (found)
+                    found[i] = hit;
             }
-            else
+            continue;
+        }
+
+        for (size_t i = 0; i < len; i++)
+        {
+            hashes[i] = hash_table_hash(table, key_bytes + (start + i) * table->key_size, table->key_size);
+            PREFETCH(&table->buckets[hashes[i] & (table->num_of_buckets - 1)]);
+        }
+
+        for (size_t i = 0; i < len; i++)
+        {
+            heads[i] = table->buckets[hashes[i] & (table->num_of_buckets - 1)];
+            if (heads[i])
             {
-                table->buckets[hash] = current->next;
+                PREFETCH(heads[i]);
+                PREFETCH((uint8_t *)heads[i] + table->arena.key_offset);
             }
+        }
 
-            current->is_free = true;
-            current->next = table->free_nodes;
-            table->free_nodes = current;
+        for (size_t i = 0; i < len; i++)
+        {
+            const uint8_t *key = key_bytes + (start + i) * table->key_size;
+            node_t *current = heads[i];
+
+            while (current && (current->is_free || current->hash != hashes[i] || current->key_len != table->key_size ||
+                               memcmp(current->key, key, table->key_size)))
+            {
+                current = current->next;
+                if (current)
+                    PREFETCH(current->next);
+            }
 
-            table->num_of_nodes--;
+            if (current)
+            {
+                memcpy(value_bytes + (start + i) * table->value_size, current->value, table->value_size);
+                hits++;
+            }
 
-            return true;
+            if (found)
+                found[start + i] = current != NULL;
         }
+    }
 
-        prev = current;
-        current = current->next;
+    return hits;
+}
+
+bool hash_table_insert_batch(hash_table_t *table, const void *keys, const void *values, size_t count)
+{
+    if (!table || !keys || !values)
+        return false;
+
+    const uint8_t *key_bytes = (const uint8_t *)keys;
+    const uint8_t *value_bytes = (const uint8_t *)values;
+
+    // grow up front for the whole batch so the prefetched buckets stay valid
+    if (!(table->flags & HASH_TABLE_INCREMENTAL_RESIZE))
+    {
+        size_t needed = table->num_of_buckets;
+        while (table->num_of_nodes + count >= BUCKET_DOUBLING_CUTOFF * needed)
+        {
+            needed *= 2;
+        }
+
+        if (needed != table->num_of_buckets && !hash_table_resize(table, needed))
+        {
+            // resizing failed; inserts below still grow the table one doubling at a time
+        }
     }
 
-    return false;
+    uint64_t hashes[BATCH_GROUP];
+
+    for (size_t start = 0; start < count; start += BATCH_GROUP)
+    {
+        size_t len = count - start < BATCH_GROUP ? count - start : BATCH_GROUP;
+
+        for (size_t i = 0; i < len; i++)
+        {
+            hashes[i] = hash_table_hash(table, key_bytes + (start + i) * table->key_size, table->key_size);
+            PREFETCH(&table->buckets[hashes[i] & (table->num_of_buckets - 1)]);
+        }
+
+        for (size_t i = 0; i < len; i++)
+        {
+            node_t *head = table->buckets[hashes[i] & (table->num_of_buckets - 1)];
+            if (head)
+                PREFETCH((uint8_t *)head + table->arena.key_offset);
+        }
+
+        for (size_t i = 0; i < len; i++)
+        {
+            bool inserted;
+            node_t *node = hash_table_find_or_add(table, key_bytes + (start + i) * table->key_size, table->key_size, hashes[i], &inserted);
+            if (!node)
+                return false;
+
+            memcpy(node->value, value_bytes + (start + i) * table->value_size, table->value_size);
+        }
+    }
+
+    return true;
 }
 
-bool hash_table_search(hash_table_t *table, const void *key, void *value)
+void hash_table_iter_init(hash_table_iter_t *iter, hash_table_t *table)
 {
-    if (!table || !key || !value)
+    iter->table = table;
+    iter->bucket = 0;
+    iter->node = NULL;
+}
+
+bool hash_table_iter_next(hash_table_iter_t *iter, const void **key, size_t *key_len, void **value)
+{
+    hash_table_t *table = iter->table;
+    if (!table)
         return false;
 
-    unsigned long hash = hash_murmur3_32(key, table->key_size) % table->num_of_buckets;
+    // old buckets below migrate_index are already NULL, so both arrays can be walked end to end
+    size_t total_buckets = table->num_of_buckets + table->old_num_of_buckets;
 
-    node_t *current = table->buckets[hash];
-    while (current)
+    for (;;)
+    {
+        while (iter->node && iter->node->is_free)
+            iter->node = iter->node->next;
+
+        if (iter->node)
+            break;
+
+        if (iter->bucket >= total_buckets)
+            return false;
+
+        iter->node = iter->bucket < table->num_of_buckets ? table->buckets[iter->bucket]
+                                                          : table->old_buckets[iter->bucket - table->num_of_buckets];
+        iter->bucket++;
+    }
+
+    node_t *node = iter->node;
+    iter->node = node->next;
+
+    if (key)
+        *key = node->key;
+    if (key_len)
+        *key_len = node->key_len;
+    if (value)
+        *value = node->value;
+    return true;
+}
+
+static size_t hash_table_scan_chain(node_t *node, hash_table_scan_fn visit, void *ctx)
+{
+    size_t visited = 0;
+    for (; node; node = node->next)
+    {
+        if (node->is_free)
+            continue;
+
+        visit(node->key, node->key_len, node->value, ctx);
+        visited++;
+    }
+    return visited;
+}
+
+// the cursor names a bucket of the smaller array; during an incremental resize the old and new arrays
+// both hold live chains, so a step visits that bucket of the smaller one and every bucket of the larger one
+// it expands into (the same walk redis's dictScan does over its two tables)
+// the scan never migrates buckets itself
+uint64_t hash_table_scan(hash_table_t *table, uint64_t cursor, size_t count, hash_table_scan_fn visit, void *ctx)
+{
+    if (!table || !visit)
+        return 0;
+
+    size_t visited = 0;
+
+    do
     {
-        if (!current->is_free && !memcmp(current->key, key, table->key_size))
+        if (!table->old_buckets)
         {
-            memcpy(value, current->value, table->value_size);
-            return true;
+            uint64_t mask = table->num_of_buckets - 1;
+            visited += hash_table_scan_chain(table->buckets[cursor & mask], visit, ctx);
+            cursor = hash_scan_next(cursor, mask);
+            continue;
         }
-        current = current->next;
+
+        node_t **small = table->old_buckets;
+        node_t **large = table->buckets;
+        uint64_t small_mask = table->old_num_of_buckets - 1;
+        uint64_t large_mask = table->num_of_buckets - 1;
+
+        if (small_mask > large_mask)
+        {
+            small = table->buckets;
+            large = table->old_buckets;
+            small_mask = table->num_of_buckets - 1;
+            large_mask = table->old_num_of_buckets - 1;
+        }
+
+        visited += hash_table_scan_chain(small[cursor & small_mask], visit, ctx);
+
+        do
+        {
+            visited += hash_table_scan_chain(large[cursor & large_mask], visit, ctx);
+            cursor = hash_scan_next(cursor, large_mask);
+        } while (cursor & (small_mask ^ large_mask));
+    } while (cursor && visited < count);
+
+    return cursor;
+}
+
+bool hash_table_save(hash_table_t *table, const char *path)
+{
+    if (!table || !path)
+        return false;
+
+    size_t total_buckets = table->num_of_buckets + table->old_num_of_buckets;
+    bool var_keys = table->flags & HASH_TABLE_VAR_KEYS;
+
+    // variable-length keys go in their own region, so its size has to be known before the file is laid out
+    size_t key_bytes = 0;
+    if (var_keys)
+    {
+        hash_table_iter_t iter;
+        size_t key_len;
+        hash_table_iter_init(&iter, table);
+        while (hash_table_iter_next(&iter, NULL, &key_len, NULL))
+            key_bytes += key_len;
     }
 
-    return false;
-}
\ No newline at end of file
+    snapshot_writer_t writer;
+    if (!snapshot_writer_open(&writer, path, var_keys ? 0 : table->key_size, table->value_size, table->num_of_nodes, key_bytes,
+                              table->hash_fn, table->seed))
+        return false;
+
+    bool ok = true;
+    for (size_t counter = 0; ok && counter < total_buckets; counter++)
+    {
+        node_t *curr = counter < table->num_of_buckets ? table->buckets[counter]
+                                                       : table->old_buckets[counter - table->num_of_buckets];
+        for (; ok && curr; curr = curr->next)
+        {
+            if (!curr->is_free)
+                ok = snapshot_writer_add(&writer, curr->key, curr->key_len, curr->value, curr->hash);
+        }
+    }
+
+    return snapshot_writer_close(&writer, path, ok);
+}
@@ -0,0 +1,53 @@
+// instantiates hash_table::HashMap and checks it against the same operations on std::unordered_map
+// c++ -std=c++11 -Wall -Wextra hash_table/test/hash_map_test.cpp -o hash_map_test && ./hash_map_test
+
+#include <cassert>
+#include <cstdio>
+#include <unordered_map>
+#include <utility>
+
+#include "../inc/hash_map.hpp"
+
+int main()
+{
+    hash_table::HashMap<uint32_t, uint64_t> map;
+    std::unordered_map<uint32_t, uint64_t> expected;
+
+    uint32_t state = 12345;
+    for (int step = 0; step < 100000; step++)
+    {
+        state = state * 1103515245U + 12345U;
+        uint32_t key = (state >> 8) % 5000;
+
+        if (state & 1)
+        {
+            map.insert(key, step);
+            expected[key] = step;
+        }
+        else
+        {
+            assert(map.remove(key) == (expected.erase(key) == 1));
+        }
+    }
+
+    assert(map.size() == expected.size());
+    for (const auto &entry : expected)
+    {
+        uint64_t value = 0;
+        assert(map.search(entry.first, value) && value == entry.second);
+    }
+
+    hash_table::HashMap<uint32_t, uint64_t> copy(map);
+    hash_table::HashMap<uint32_t, uint64_t> moved(std::move(map));
+    assert(copy.size() == expected.size() && moved.size() == expected.size() && map.size() == 0);
+
+    copy.clear();
+    assert(copy.size() == 0 && moved.size() == expected.size());
+
+    moved.reserve(1 << 16);
+    for (const auto &entry : expected)
+        assert(*moved.get(entry.first) == entry.second);
+
+    std::printf("hash_map: ok\n");
+    return 0;
+}
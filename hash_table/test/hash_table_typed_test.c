@@ -0,0 +1,67 @@
+// instantiates HASH_TABLE_DEFINE for an integer key and a struct key and checks it against a plain array
+// cc -std=gnu11 -Wall -Wextra hash_table/test/hash_table_typed_test.c -o typed_test && ./typed_test
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "../inc/hash_table_typed.h"
+
+HASH_TABLE_DEFINE_INT(u32_map, uint32_t, uint64_t)
+
+typedef struct
+{
+    int32_t x;
+    int32_t y;
+} point_t;
+
+#define POINT_HASH(p) (hash_table_mix64(((uint64_t)(uint32_t)(p).x << 32) | (uint32_t)(p).y))
+#define POINT_EQ(a, b) ((a).x == (b).x && (a).y == (b).y)
+
+HASH_TABLE_DEFINE(point_map, point_t, int, POINT_HASH, POINT_EQ)
+
+#define NUM_OF_KEYS (20000U)
+
+int main(void)
+{
+    u32_map_t map = {0};
+
+    for (uint32_t key = 0; key < NUM_OF_KEYS; key++)
+        assert(u32_map_insert(&map, key * 7, (uint64_t)key * 3));
+    assert(u32_map_size(&map) == NUM_OF_KEYS);
+
+    for (uint32_t key = 0; key < NUM_OF_KEYS; key += 2)
+        assert(u32_map_remove(&map, key * 7));
+    assert(!u32_map_remove(&map, 0));
+
+    for (uint32_t key = 0; key < NUM_OF_KEYS; key++)
+    {
+        uint64_t value;
+        bool found = u32_map_search(&map, key * 7, &value);
+        assert(found == (key % 2 == 1));
+        assert(!found || value == (uint64_t)key * 3);
+    }
+
+    assert(u32_map_insert(&map, 7, 42));
+    assert(*u32_map_get(&map, 7) == 42);
+    assert(u32_map_reserve(&map, 4 * NUM_OF_KEYS));
+    assert(u32_map_size(&map) == NUM_OF_KEYS / 2 && *u32_map_get(&map, 7) == 42);
+
+    u32_map_clear(&map);
+    assert(!u32_map_size(&map) && !u32_map_get(&map, 7));
+    u32_map_destroy(&map);
+
+    point_map_t points;
+    assert(point_map_init(&points, 100));
+    for (int32_t x = -50; x < 50; x++)
+        assert(point_map_insert(&points, (point_t){x, -x}, x));
+    for (int32_t x = -50; x < 50; x++)
+    {
+        int value;
+        assert(point_map_search(&points, (point_t){x, -x}, &value) && value == x);
+        assert(!point_map_search(&points, (point_t){x, x + 1}, NULL));
+    }
+    point_map_destroy(&points);
+
+    printf("hash_table_typed: ok\n");
+    return 0;
+}
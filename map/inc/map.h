@@ -1,22 +1,97 @@
 #ifndef MAP_H
 #define MAP_H
 
-#include "../../dyn_arr/inc/dyn_arr.h"
-#include "../../stack/inc/stack.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../../hash/inc/hash.h"
+
+#define MAP_SMALL_MAX_ENTRIES (8U) // a map holding at most this many entries keeps them in a plain array
 
 typedef struct
 {
-    dyn_arr_t *arr;
-    stack_t *allocated;
-    size_t key_size;
+    uint8_t *slots;      // curr_max_len fixed-stride slots, robin hood ordered; key and value bytes live in the slot
+    uint8_t *scratch;    // one slot image, for an entry being built or moved before map_place copies it in
+    size_t slot_size;    // stride of one slot (header + key + value, aligned)
+    size_t key_offset;   // offset of the key bytes inside a slot
+    size_t value_offset; // offset of the value bytes inside a slot
+    size_t key_size;     // 0 for a map made by map_create_var
     size_t value_size;
-    size_t curr_max_len;
+    size_t curr_max_len; // always a power of two, or 0 for a small map that has not allocated yet
+    size_t num_of_entries;
+    bool is_small;       // entries are packed in slots[0, num_of_entries) and found by a linear scan, unhashed
+    hash_fn_t hash_fn; // slot index is hash_fn(key) & (curr_max_len - 1)
+    uint64_t seed;
 } map_t;
 
 bool map_insert(map_t *map, void *key, void *value);
 bool map_remove(map_t *map, void *key);
 bool map_search(map_t *map, void *key, void *value);
+
+// returns a pointer to key's value inside the map instead of copying it out, or NULL if key is missing
+// values live inline in the slot array, which inserts and removes shift and growing redistributes, so the pointer
+// is only good until the next map_insert or map_remove (of any key) or map_destroy
+const void *map_get_ptr(map_t *map, const void *key);
+// batched search and insert: keys and values are packed arrays of count entries
+// each group of keys is hashed and its slots prefetched before any of them is probed
+// search_batch fills values (if non-NULL) and found (if non-NULL) per key and returns the hit count
+size_t map_search_batch(map_t *map, const void *keys, size_t count, void *values, bool *found);
+bool map_insert_batch(map_t *map, const void *keys, const void *values, size_t count); // false if any insert failed
+
+// variable-length keys: each key is stored at its own length and hashed and compared over key_len bytes only
+// on a fixed-size map key_len must equal key_size; a map_create_var map rejects the fixed-size calls above
+bool map_insert_var(map_t *map, void *key, size_t key_len, void *value);
+bool map_remove_var(map_t *map, void *key, size_t key_len);
+bool map_search_var(map_t *map, void *key, size_t key_len, void *value);
+const void *map_get_ptr_var(map_t *map, const void *key, size_t key_len);
+
+// the same calls for a caller that has already hashed key, such as a wrapper that spreads keys over several maps
+// full_hash must be what the map's own hash_fn and seed give for key; a small map ignores it
+bool map_insert_hashed(map_t *map, const void *key, size_t key_len, const void *value, uint64_t full_hash);
+bool map_remove_hashed(map_t *map, const void *key, size_t key_len, uint64_t full_hash);
+const void *map_get_ptr_hashed(map_t *map, const void *key, size_t key_len, uint64_t full_hash);
+
+// calls visit(key, key_len, value, ctx) on every entry until it returns false; returns false if it stopped early
+// visit may rewrite the value in place but must not insert into or remove from the map
+typedef bool (*map_visit_fn)(const void *key, size_t key_len, void *value, void *ctx);
+bool map_foreach(map_t *map, map_visit_fn visit, void *ctx);
+
+// walks every entry in slot order, one flat pass over the slot array; the map must not be inserted into or
+// removed from between iter_init and the last iter_next, but values may be rewritten in place
+typedef struct
+{
+    map_t *map;
+    size_t index; // next slot to look at
+} map_iter_t;
+
+void map_iter_init(map_iter_t *iter, map_t *map);
+bool map_iter_next(map_iter_t *iter, const void **key, size_t *key_len, void **value); // false once done
+
+// resumable scan in the style of redis SCAN: start with cursor 0, feed each returned cursor back in,
+// and stop when it comes back 0; each call visits whole home slots until at least count entries were seen
+// the map may be written to and grow between calls, and every key present for the whole scan is still
+// visited at least once; keys may be visited twice across a resize
+// the cursor is a plain integer, so it can be stored and the scan resumed later
+// visit must not call back into the map
+typedef void (*map_scan_fn)(const void *key, size_t key_len, void *value, void *ctx);
+uint64_t map_scan(map_t *map, uint64_t cursor, size_t count, map_scan_fn visit, void *ctx);
+
+// writes every entry to path as a snapshot (see snapshot.h), searched in place after snapshot_open maps it
+// every entry is re-placed into the file's slot array through snapshot_writer_add; a hashed map passes its stored
+// hashes along, a small map hashes its entries first
+bool map_save(map_t *map, const char *path);
+
+// a new map starts small and allocates nothing until its first insert; once it outgrows MAP_SMALL_MAX_ENTRIES
+// its entries are hashed into a robin hood table
 map_t *map_create(size_t key_size, size_t value_size); // key and value size in bytes
+// sized for capacity entries up front: small if capacity fits MAP_SMALL_MAX_ENTRIES, hashed and grow-free otherwise
+map_t *map_create_with_capacity(size_t key_size, size_t value_size, size_t capacity);
+map_t *map_create_var(size_t value_size);              // keys of any length, such as strings or blobs
 bool map_destroy(map_t *map);
 
+// swaps in another hash function (HASH_FN_DEFAULT is used otherwise); only allowed while the map is empty
+bool map_set_hash_fn(map_t *map, hash_fn_t hash_fn, uint64_t seed);
+
 #endif
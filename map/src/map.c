@@ -1,700 +1,1002 @@
 #include "../inc/map.h"
+#include "../../snapshot/inc/snapshot.h"
 #include <stdio.h>
+#include <stddef.h>
 
-static bool map_insert_rehash(map_t *map, void *key_ptr, void *value_ptr);
-static bool rehash(map_t *map);
-static inline uint32_t rotl32(uint32_t x, int r);
+static bool map_insert_with_hash(map_t *map, const void *key, size_t key_len, const void *value, uint64_t full_hash);
+static const void *map_lookup(map_t *map, const void *key, size_t key_len, uint64_t full_hash);
+static map_t *map_create_sized(size_t key_size, size_t value_size, size_t capacity);
+static bool map_grow(map_t *map);
+static size_t map_small_find(const map_t *map, const void *key, size_t key_len);
+static bool map_small_insert(map_t *map, const void *key, size_t key_len, const void *value);
 
+// every slot starts with this header, followed by the key bytes and then the value bytes
+// a map_create_var map keeps a pointer to the key's own allocation where the key bytes would go
 typedef struct
 {
-    void *key;
-    void *value;
-    bool is_empty;
-} map_node_t;
+    uint64_t hash;    // full hash of key; gives every entry's home slot, so growing and robin hood probing never rehash keys
+    uint32_t key_len; // always key_size unless the map was made by map_create_var
+    bool used;        // false for an empty slot; a zeroed table is an empty one
+} map_slot_t;
 
-#define SEED 0x9747b28c
-#define BUCKET_DOUBLING_CUTOFF (0.47)
+#define BUCKET_DOUBLING_CUTOFF (0.8) // robin hood keeps probe lengths short and even well past half full
 
-#include <stdint.h>
-#include <stddef.h>
+#define MAP_SMALL_MIN_LEN (2U)   // slots in a small map's first array; doubles up to MAP_SMALL_MAX_ENTRIES
+#define MAP_HASHED_MIN_LEN (16U) // slots in the robin hood table a small map turns into
+
+#define BATCH_GROUP (16U) // keys whose memory accesses are overlapped by the batch calls
+
+#define PREFETCH(addr) __builtin_prefetch((addr), 0, 3)
 
-#define XXH_PRIME32_1 2654435761U
-#define XXH_PRIME32_2 2246822519U
-#define XXH_PRIME32_3 3266489917U
-#define XXH_PRIME32_4 668265263U
-#define XXH_PRIME32_5 374761393U
+#define ALIGN_UP(x, a) (((x) + ((a) - 1)) & ~((size_t)(a) - 1))
 
-static inline uint32_t rotl32(uint32_t x, int r)
+static inline uint64_t map_hash(const map_t *map, const void *key, size_t key_len)
 {
-    return (x << r) | (x >> (32 - r));
+    return map->hash_fn(key, key_len, map->seed);
 }
 
-static inline uint32_t xxh32(const void *key, size_t len)
+// fixed-size maps only ever see key_size; variable-length ones take anything that fits map_slot_t's key_len
+static inline bool map_key_len_ok(const map_t *map, size_t key_len)
 {
-    const uint8_t *p = (const uint8_t *)key;
-    uint32_t h32;
-
-    if (len <= 4)
+    if (!map->key_size)
     {
-        const uint8_t *p = (const uint8_t *)key;
-        uint32_t h32 = SEED + XXH_PRIME32_5;
-
-        h32 += (uint32_t)len;
+        return key_len <= UINT32_MAX;
+    }
+    return key_len == map->key_size;
+}
 
-        switch (len)
-        {
-        case 4:
-            h32 += ((uint32_t)p[3]) << 24;
-        case 3:
-            h32 += ((uint32_t)p[2]) << 16;
-        case 2:
-            h32 += ((uint32_t)p[1]) << 8;
-        case 1:
-            h32 += (uint32_t)p[0];
-            h32 *= XXH_PRIME32_3;
-            h32 = rotl32(h32, 17) * XXH_PRIME32_4;
-        }
+// an empty variable-length key still gets a real allocation, so a live slot never has a NULL key
+static inline void *map_key_alloc(size_t key_len)
+{
+    return malloc(key_len ? key_len : 1);
+}
 
-        h32 ^= h32 >> 15;
-        h32 *= XXH_PRIME32_2;
-        h32 ^= h32 >> 13;
-        h32 *= XXH_PRIME32_3;
-        h32 ^= h32 >> 16;
+static inline map_slot_t *map_slot(const map_t *map, size_t index)
+{
+    return (map_slot_t *)(map->slots + index * map->slot_size);
+}
 
-        return h32;
+// the key bytes of a live slot, wherever they are stored
+static inline const void *map_slot_key(const map_t *map, const map_slot_t *slot)
+{
+    const uint8_t *key = (const uint8_t *)slot + map->key_offset;
+    if (!map->key_size)
+    {
+        void *ptr;
+        memcpy(&ptr, key, sizeof(void *));
+        return ptr;
     }
+    return key;
+}
 
-    if (len >= 16)
+static inline void *map_slot_value(const map_t *map, const map_slot_t *slot)
+{
+    return (uint8_t *)slot + map->value_offset;
+}
+
+static inline void map_slot_free_key(const map_t *map, const map_slot_t *slot)
+{
+    if (!map->key_size)
     {
-        const uint32_t *blocks = (const uint32_t *)p;
-        size_t nblocks = len / 16;
-        uint32_t v1 = SEED + XXH_PRIME32_1 + XXH_PRIME32_2;
-        uint32_t v2 = SEED + XXH_PRIME32_2;
-        uint32_t v3 = SEED + 0;
-        uint32_t v4 = SEED - XXH_PRIME32_1;
+        free((void *)map_slot_key(map, slot));
+    }
+}
 
-        for (size_t i = 0; i < nblocks; i++)
-        {
-            v1 += blocks[i * 4] * XXH_PRIME32_2;
-            v1 = rotl32(v1, 13);
-            v1 *= XXH_PRIME32_1;
+bool map_search(map_t *map, void *key, void *value)
+{
+    if (!map || !map->key_size)
+    {
+        return false;
+    }
 
-            v2 += blocks[i * 4 + 1] * XXH_PRIME32_2;
-            v2 = rotl32(v2, 13);
-            v2 *= XXH_PRIME32_1;
+    return map_search_var(map, key, map->key_size, value);
+}
 
-            v3 += blocks[i * 4 + 2] * XXH_PRIME32_2;
-            v3 = rotl32(v3, 13);
-            v3 *= XXH_PRIME32_1;
+bool map_search_var(map_t *map, void *key, size_t key_len, void *value)
+{
+    const void *stored = map_get_ptr_var(map, key, key_len);
+    if (!stored)
+    {
+        return false;
+    }
 
-            v4 += blocks[i * 4 + 3] * XXH_PRIME32_2;
-            v4 = rotl32(v4, 13);
-            v4 *= XXH_PRIME32_1;
-        }
+    if (value)
+    {
+        memcpy(value, stored, map->value_size);
+    }
+    return true;
+}
 
-        h32 = rotl32(v1, 1) + rotl32(v2, 7) + rotl32(v3, 12) + rotl32(v4, 18);
+const void *map_get_ptr(map_t *map, const void *key)
+{
+    if (!map || !map->key_size)
+    {
+        return NULL;
     }
-    else
+
+    return map_get_ptr_var(map, key, map->key_size);
+}
+
+const void *map_get_ptr_var(map_t *map, const void *key, size_t key_len)
+{
+    if (!map || !key || !map_key_len_ok(map, key_len))
     {
-        h32 = SEED + XXH_PRIME32_5;
+        return NULL;
     }
 
-    h32 += (uint32_t)len;
+    // a small map is scanned, never probed, so it skips hashing altogether
+    return map_get_ptr_hashed(map, key, key_len, map->is_small ? 0 : map_hash(map, key, key_len));
+}
 
-    while (len >= 4)
+const void *map_get_ptr_hashed(map_t *map, const void *key, size_t key_len, uint64_t full_hash)
+{
+    if (!map || !key || !map_key_len_ok(map, key_len))
     {
-        h32 += (*(const uint32_t *)p) * XXH_PRIME32_3;
-        h32 = rotl32(h32, 17) * XXH_PRIME32_4;
-        p += 4;
-        len -= 4;
+        return NULL;
     }
 
-    while (len > 0)
+    if (map->is_small)
     {
-        h32 += (*p++) * XXH_PRIME32_5;
-        h32 = rotl32(h32, 11) * XXH_PRIME32_1;
-        len--;
+        size_t index = map_small_find(map, key, key_len);
+        return index == map->curr_max_len ? NULL : map_slot_value(map, map_slot(map, index));
     }
 
-    h32 ^= h32 >> 15;
-    h32 *= XXH_PRIME32_2;
-    h32 ^= h32 >> 13;
-    h32 *= XXH_PRIME32_3;
-    h32 ^= h32 >> 16;
+    return map_lookup(map, key, key_len, full_hash);
+}
+
+// how far the entry in slot index sits from its home slot
+static inline size_t map_probe_dist(const map_t *map, size_t index, uint64_t full_hash)
+{
+    return (index - ((size_t)full_hash & (map->curr_max_len - 1))) & (map->curr_max_len - 1);
+}
 
-    return h32;
+static inline bool map_slot_key_equals(const map_t *map, const map_slot_t *slot, const void *key, size_t key_len)
+{
+    if (map->key_size == 4)
+    {
+        // the caller's key need not be aligned either, so both sides are loaded with memcpy
+        uint32_t stored;
+        uint32_t wanted;
+        memcpy(&stored, map_slot_key(map, slot), 4);
+        memcpy(&wanted, key, 4);
+        return stored == wanted;
+    }
+
+    return slot->key_len == key_len && !memcmp(map_slot_key(map, slot), key, key_len);
 }
 
-bool map_search(map_t *map, void *key, void *value)
+static inline bool map_slot_matches(const map_t *map, const map_slot_t *slot, const void *key, size_t key_len, uint64_t full_hash)
 {
-    if (!map || !key)
+    if (slot->hash != full_hash)
     {
+        // different hash, so a different key; no need to touch the key's memory
         return false;
     }
 
-    if (!map->allocated || !map->arr)
+    return map_slot_key_equals(map, slot, key, key_len);
+}
+
+// small mode: the entries are packed in slots[0, num_of_entries) and found by a scan that never hashes
+// returns the slot holding key, or curr_max_len if key is missing
+static size_t map_small_find(const map_t *map, const void *key, size_t key_len)
+{
+    for (size_t index = 0; index < map->num_of_entries; index++)
     {
-        return false;
+        if (map_slot_key_equals(map, map_slot(map, index), key, key_len))
+        {
+            return index;
+        }
     }
 
-    stack_t *allocated = map->allocated;
-    dyn_arr_t *arr = map->arr;
-
-    size_t hash = (size_t)xxh32(key, map->key_size) & (map->curr_max_len - 1);
-    size_t original_hash = hash;
+    return map->curr_max_len;
+}
 
-    map_node_t node;
+// returns the slot holding key, or curr_max_len if key is missing
+// robin hood keeps every entry at least as far from home as any key that probes past it,
+// so the probe stops at the first entry closer to its home than we are to ours
+static size_t map_find(map_t *map, const void *key, size_t key_len, uint64_t full_hash)
+{
+    size_t mask = map->curr_max_len - 1;
+    size_t hash = (size_t)full_hash & mask;
 
-    while (true)
+    for (size_t dist = 0; dist < map->curr_max_len; dist++)
     {
-        if (!dyn_arr_get(arr, hash, &node))
-        {
-            return false;
-        }
+        const map_slot_t *slot = map_slot(map, hash);
 
-        if (node.is_empty)
+        if (!slot->used || map_probe_dist(map, hash, slot->hash) < dist)
         {
-            return false;
+            return map->curr_max_len;
         }
 
-        if (map->key_size <= 4)
+        if (map_slot_matches(map, slot, key, key_len, full_hash))
         {
-            if (*((uint32_t *)node.key) == *((uint32_t *)key))
-            {
-                if (value)
-                {
-                    memcpy(value, node.value, map->value_size);
-                }
-                return true;
-            }
-        }
-        else if (!memcmp(node.key, key, map->key_size))
-        {
-            if (value)
-            {
-                memcpy(value, node.value, map->value_size);
-            }
-            return true;
+            return hash;
         }
 
-        hash = (hash + 1) & (map->curr_max_len - 1); // linear probing
-        if (hash == original_hash)
-        {
-            return false;
-        }
+        hash = (hash + 1) & mask; // linear probing
     }
 
-    return false;
+    return map->curr_max_len;
 }
 
-// we don't actually remove the map_node; we just mark it as free and also free the corresponding key and value
-bool map_remove(map_t *map, void *key)
+static const void *map_lookup(map_t *map, const void *key, size_t key_len, uint64_t full_hash)
 {
-    // we also don't remove this key from the allocated stack
-    // so when we rehash, we should also check if the element from the allocated stack is not empty
-    if (!map || !key)
+    size_t index = map_find(map, key, key_len, full_hash);
+    if (index == map->curr_max_len)
     {
-        return false;
+        return NULL;
     }
 
-    if (!map->allocated || !map->arr)
+    return map_slot_value(map, map_slot(map, index));
+}
+
+bool map_remove(map_t *map, void *key)
+{
+    if (!map || !map->key_size)
     {
         return false;
     }
 
-    dyn_arr_t *arr = map->arr;
-
-    stack_t *alloc = map->allocated;
+    return map_remove_var(map, key, map->key_size);
+}
 
-    stack_t *new_alloc = stack_create(alloc->data_size);
-    if (!new_alloc)
+bool map_remove_var(map_t *map, void *key, size_t key_len)
+{
+    if (!map || !key || !map_key_len_ok(map, key_len))
     {
         return false;
     }
 
-    size_t hash = (size_t)xxh32(key, map->key_size) & (map->curr_max_len - 1);
-    size_t original_hash = hash;
+    return map_remove_hashed(map, key, key_len, map->is_small ? 0 : map_hash(map, key, key_len));
+}
 
-    map_node_t node;
+// backward-shift deletion: the entries after the removed one slide back a slot until one is already
+// at home (or the run ends), so no tombstone is left behind and probe lengths shrink again
+bool map_remove_hashed(map_t *map, const void *key, size_t key_len, uint64_t full_hash)
+{
+    if (!map || !key || !map_key_len_ok(map, key_len))
+    {
+        return false;
+    }
 
-    while (true)
+    if (map->is_small)
     {
-        if (!dyn_arr_get(arr, hash, &node))
+        size_t index = map_small_find(map, key, key_len);
+        if (index == map->curr_max_len)
         {
-            // this means the dynamic array node containing the index hash is not allocated
-            // this is possible only if the current key is not present in the table since we never actually
-            // destroy any map_node or dynamic array node
             return false;
         }
 
-        if (node.is_empty)
+        // the last entry fills the hole, so the array stays packed
+        size_t last = map->num_of_entries - 1;
+        map_slot_free_key(map, map_slot(map, index));
+        if (index != last)
         {
-            // Empty slot means key is not in the map
-            return false;
+            memcpy(map_slot(map, index), map_slot(map, last), map->slot_size);
         }
+        memset(map_slot(map, last), 0, map->slot_size);
 
-        if (!memcmp(node.key, key, map->key_size))
-        {
-            // the keys are equal
-            void *key_ptr = node.key;
-            void *value_ptr = node.value;
+        map->num_of_entries--;
+        return true;
+    }
 
-            node.is_empty = true;
-            node.key = NULL;
-            node.value = NULL;
+    size_t mask = map->curr_max_len - 1;
 
-            // remove the found index from the allocated stack
-            size_t elt;
-            for (size_t index = 0; index < alloc->stack_size; index++)
-            {
-                if (!stack_pop(alloc, &elt))
-                {
-                    stack_delete(new_alloc);
-                    return false;
-                }
+    size_t hash = map_find(map, key, key_len, full_hash);
+    if (hash == map->curr_max_len)
+    {
+        return false;
+    }
 
-                if (elt != hash)
-                {
-                    if (!stack_push(new_alloc, &elt))
-                    {
-                        stack_delete(new_alloc);
-                        return false;
-                    }
-                }
-            }
+    map_slot_free_key(map, map_slot(map, hash));
 
-            map->allocated = new_alloc;
-            stack_delete(alloc);
+    size_t next = (hash + 1) & mask;
+    while (map_slot(map, next)->used && map_probe_dist(map, next, map_slot(map, next)->hash))
+    {
+        memcpy(map_slot(map, hash), map_slot(map, next), map->slot_size);
+        hash = next;
+        next = (next + 1) & mask;
+    }
 
-            if (!dyn_arr_set(arr, hash, &node))
-            {
-                return false;
-            }
+    memset(map_slot(map, hash), 0, map->slot_size);
 
-            free(key_ptr);
-            free(value_ptr);
+    map->num_of_entries--;
+    return true;
+}
 
-            return true;
-        }
+// robin hood placement of an entry (a whole slot image) whose key is known to be missing
+// the entry goes to the first slot that is empty or holds an entry closer to its home than this one would be,
+// and the run from there up to the next empty slot shifts forward by one, which keeps the robin hood order
+// returns the slot the entry landed in
+static size_t map_place(map_t *map, const map_slot_t *entry)
+{
+    size_t mask = map->curr_max_len - 1;
+    size_t hash = (size_t)entry->hash & mask;
 
-        hash = (hash + 1) & (map->curr_max_len - 1); // linear probing
-        if (hash == original_hash)
-        {
-            // we've checked all positions and didn't find the key
-            return false;
-        }
+    // the load factor guarantees an empty slot, so neither scan can wrap all the way round
+    for (size_t dist = 0; map_slot(map, hash)->used && map_probe_dist(map, hash, map_slot(map, hash)->hash) >= dist; dist++)
+    {
+        hash = (hash + 1) & mask;
     }
 
-    return false;
+    size_t target = hash;
+    while (map_slot(map, hash)->used)
+    {
+        hash = (hash + 1) & mask;
+    }
+
+    while (hash != target)
+    {
+        size_t prev = (hash - 1) & mask;
+        memcpy(map_slot(map, hash), map_slot(map, prev), map->slot_size);
+        hash = prev;
+    }
+
+    memcpy(map_slot(map, target), entry, map->slot_size);
+    map->num_of_entries++;
+    return target;
 }
 
-static bool rehash(map_t *map)
+// doubles the slot array in place: one realloc, then every entry moves to its slot in the doubled table
+// a doubled table keeps each entry's home (h) or moves it to h + old length, and slot order is robin hood (home)
+// order, so visiting entries by slot lands each one at or below its old slot or in the new upper half,
+// never on an entry not visited yet; the run wrapping past the last old slot is the one exception,
+// so it is set aside first and placed last
+static bool map_grow(map_t *map)
 {
-    if (!map || !map->allocated || !map->arr)
+    size_t old_len = map->curr_max_len;
+    size_t new_len = old_len << 1U;
+    size_t slot_size = map->slot_size;
+
+    // the wrapping run is [wrap_start, old_len) followed by [0, wrap_end); the load factor keeps a slot empty
+    size_t wrap_start = old_len;
+    size_t wrap_end = 0;
+    if (map_slot(map, 0)->used && map_slot(map, old_len - 1)->used)
     {
-        return false;
+        while (map_slot(map, wrap_end)->used)
+        {
+            wrap_end++;
+        }
+        while (map_slot(map, wrap_start - 1)->used)
+        {
+            wrap_start--;
+        }
     }
 
-    stack_t *old_allocated = map->allocated;
-    dyn_arr_t *arr = map->arr;
-    size_t len = old_allocated->stack_size;
-
-    typedef struct
+    size_t wrap_count = (old_len - wrap_start) + wrap_end;
+    uint8_t *wrapped = NULL;
+    if (wrap_count)
     {
-        void *key;
-        void *value;
-    } key_value_pair;
+        wrapped = malloc(wrap_count * slot_size);
+        if (!wrapped)
+        {
+            return false;
+        }
+    }
 
-    key_value_pair *pairs = malloc(len * sizeof(key_value_pair));
-    if (!pairs)
+    uint8_t *slots = realloc(map->slots, new_len * slot_size);
+    if (!slots)
     {
+        free(wrapped);
         return false;
     }
 
-    size_t pair_count = 0;
-    size_t hash_index;
-    map_node_t node;
+    if (wrap_count)
+    {
+        memcpy(wrapped, slots + wrap_start * slot_size, (old_len - wrap_start) * slot_size);
+        memcpy(wrapped + (old_len - wrap_start) * slot_size, slots, wrap_end * slot_size);
+        memset(slots, 0, wrap_end * slot_size);
+    }
+    memset(slots + wrap_start * slot_size, 0, (new_len - wrap_start) * slot_size);
 
-    for (size_t i = 0; i < len; i++)
+    map->slots = slots;
+    map->curr_max_len = new_len;
+    map->num_of_entries = 0;
+
+    // each entry is lifted into the scratch slot (allocated with the map, so growth never needs more memory
+    // than the realloc and the wrapped run) before its old slot is cleared and it is placed again
+    for (size_t index = wrap_end; index < wrap_start; index++)
     {
-        if (!stack_pop(old_allocated, &hash_index))
+        map_slot_t *slot = map_slot(map, index);
+        if (!slot->used)
         {
-            free(pairs);
-            return false;
+            continue;
         }
 
-        if (!dyn_arr_get(arr, hash_index, &node))
-        {
-            free(pairs);
-            return false;
-        }
+        memcpy(map->scratch, slot, slot_size);
+        memset(slot, 0, slot_size);
+        map_place(map, (const map_slot_t *)map->scratch);
+    }
 
-        if (!node.is_empty)
-        {
-            pairs[pair_count].key = node.key;
-            pairs[pair_count].value = node.value;
-            pair_count++;
+    // every slot now holds a placed entry, so the ordinary robin hood shifts are safe
+    for (size_t index = 0; index < wrap_count; index++)
+    {
+        map_place(map, (const map_slot_t *)(wrapped + index * slot_size));
+    }
 
-            node.key = NULL;
-            node.value = NULL;
-            node.is_empty = true;
+    free(wrapped);
+    return true;
+}
 
-            if (!dyn_arr_set(arr, hash_index, &node))
-            {
-                free(pairs);
-                return false;
-            }
-        }
+bool map_insert(map_t *map, void *key, void *value)
+{
+    if (!map || !map->key_size)
+    {
+        return false;
     }
 
-    stack_t *new_allocated = stack_create(sizeof(size_t));
-    if (!new_allocated)
+    return map_insert_var(map, key, map->key_size, value);
+}
+
+bool map_insert_var(map_t *map, void *key, size_t key_len, void *value)
+{
+    if (!map || !key || !value || !map_key_len_ok(map, key_len))
     {
-        free(pairs);
         return false;
     }
 
-    map->allocated = new_allocated;
+    return map_insert_hashed(map, key, key_len, value, map->is_small ? 0 : map_hash(map, key, key_len));
+}
 
-    for (size_t i = 0; i < pair_count; i++)
+bool map_insert_hashed(map_t *map, const void *key, size_t key_len, const void *value, uint64_t full_hash)
+{
+    if (!map || !key || !value || !map_key_len_ok(map, key_len))
     {
-        if (!map_insert_rehash(map, pairs[i].key, pairs[i].value))
-        {
-            for (size_t j = i; j < pair_count; j++)
-            {
-                free(pairs[j].key);
-                free(pairs[j].value);
-            }
+        return false;
+    }
 
-            stack_delete(new_allocated);
+    if (map->is_small)
+    {
+        return map_small_insert(map, key, key_len, value);
+    }
 
-            map->allocated = old_allocated;
+    return map_insert_with_hash(map, key, key_len, value, full_hash);
+}
+
+// writes a complete slot image for key and value into dst (slot_size bytes)
+static bool map_build_entry(const map_t *map, uint8_t *dst, const void *key, size_t key_len, const void *value, uint64_t full_hash)
+{
+    memset(dst, 0, map->slot_size);
 
-            free(pairs);
+    map_slot_t *entry = (map_slot_t *)dst;
+    entry->hash = full_hash;
+    entry->key_len = (uint32_t)key_len;
+    entry->used = true;
+
+    if (map->key_size)
+    {
+        memcpy(dst + map->key_offset, key, key_len);
+    }
+    else
+    {
+        // the key outlives the slot image, so a variable-length key gets its own allocation
+        void *key_copy = map_key_alloc(key_len);
+        if (!key_copy)
+        {
+            memset(dst, 0, map->slot_size);
             return false;
         }
-    }
 
-    stack_delete(old_allocated);
+        memcpy(key_copy, key, key_len);
+        memcpy(dst + map->key_offset, &key_copy, sizeof(void *));
+    }
 
-    free(pairs);
+    memcpy(dst + map->value_offset, value, map->value_size);
     return true;
 }
 
-bool map_insert_rehash(map_t *map, void *key_ptr, void *value_ptr)
+static bool map_insert_with_hash(map_t *map, const void *key, size_t key_len, const void *value, uint64_t full_hash)
 {
-    if (!map || !key_ptr || !value_ptr)
+    size_t index = map_find(map, key, key_len, full_hash);
+    if (index != map->curr_max_len)
     {
-        return false;
+        // update existing key's value
+        memcpy(map_slot_value(map, map_slot(map, index)), value, map->value_size);
+        return true;
     }
 
-    if (!map->allocated || !map->arr)
+    if (map->num_of_entries + 1 > BUCKET_DOUBLING_CUTOFF * map->curr_max_len)
     {
-        return false;
+        // double the number of slots in place
+        if (!map_grow(map))
+        {
+            return false;
+        }
     }
 
-    stack_t *allocated = map->allocated;
-    dyn_arr_t *arr = map->arr;
-
-    size_t hash = (size_t)xxh32(key_ptr, map->key_size) & (map->curr_max_len - 1);
-    size_t original_hash = hash;
+    // the entry is built in the map's scratch slot and then placed as one slot image
+    if (!map_build_entry(map, map->scratch, key, key_len, value, full_hash))
+    {
+        return false;
+    }
 
-    map_node_t node;
+    map_place(map, (const map_slot_t *)map->scratch);
+    return true;
+}
 
-    while (true)
+// leaves small mode: hashes every entry once and places it in a robin hood table of new_len slots
+static bool map_promote(map_t *map, size_t new_len)
+{
+    uint8_t *slots = calloc(new_len, map->slot_size);
+    if (!slots)
     {
-        if (!dyn_arr_get(arr, hash, &node))
-        {
-            node.key = key_ptr;
-            node.value = value_ptr;
-            node.is_empty = false;
+        return false;
+    }
 
-            if (!dyn_arr_set(arr, hash, &node))
-            {
-                return false;
-            }
+    uint8_t *small = map->slots;
+    size_t count = map->num_of_entries;
 
-            if (!stack_push(allocated, &hash))
-            {
-                return false;
-            }
+    map->slots = slots;
+    map->curr_max_len = new_len;
+    map->num_of_entries = 0;
+    map->is_small = false;
 
-            return true;
-        }
+    for (size_t index = 0; index < count; index++)
+    {
+        map_slot_t *slot = (map_slot_t *)(small + index * map->slot_size);
+        slot->hash = map_hash(map, map_slot_key(map, slot), slot->key_len);
+        map_place(map, slot);
+    }
 
-        if (node.is_empty)
-        {
-            node.key = key_ptr;
-            node.value = value_ptr;
-            node.is_empty = false;
+    free(small);
+    return true;
+}
 
-            if (!dyn_arr_set(arr, hash, &node))
-            {
-                return false;
-            }
+static bool map_small_insert(map_t *map, const void *key, size_t key_len, const void *value)
+{
+    size_t index = map_small_find(map, key, key_len);
+    if (index != map->curr_max_len)
+    {
+        memcpy(map_slot_value(map, map_slot(map, index)), value, map->value_size);
+        return true;
+    }
 
-            if (!stack_push(allocated, &hash))
+    if (map->num_of_entries == map->curr_max_len)
+    {
+        if (map->curr_max_len >= MAP_SMALL_MAX_ENTRIES)
+        {
+            if (!map_promote(map, MAP_HASHED_MIN_LEN))
             {
                 return false;
             }
-
-            return true;
+            return map_insert_with_hash(map, key, key_len, value, map_hash(map, key, key_len));
         }
 
-        hash = (hash + 1) & (map->curr_max_len - 1);
-        if (hash == original_hash)
+        size_t new_len = map->curr_max_len ? map->curr_max_len * 2 : MAP_SMALL_MIN_LEN;
+        uint8_t *slots = realloc(map->slots, new_len * map->slot_size);
+        if (!slots)
         {
             return false;
         }
+
+        memset(slots + map->curr_max_len * map->slot_size, 0, (new_len - map->curr_max_len) * map->slot_size);
+        map->slots = slots;
+        map->curr_max_len = new_len;
     }
 
-    return false;
+    // small entries are never probed by hash, so the hash is only filled in by map_promote
+    if (!map_build_entry(map, (uint8_t *)map_slot(map, map->num_of_entries), key, key_len, value, 0))
+    {
+        return false;
+    }
+
+    map->num_of_entries++;
+    return true;
 }
 
-bool map_insert(map_t *map, void *key, void *value)
+map_t *map_create(size_t key_size, size_t value_size)
 {
-    if (!map || !key || !value)
+    if (!key_size)
     {
-        return false;
+        return NULL;
     }
 
-    if (!map->allocated || !map->arr)
+    return map_create_sized(key_size, value_size, 0);
+}
+
+map_t *map_create_with_capacity(size_t key_size, size_t value_size, size_t capacity)
+{
+    if (!key_size)
     {
-        return false;
+        return NULL;
+    }
+
+    return map_create_sized(key_size, value_size, capacity);
+}
+
+map_t *map_create_var(size_t value_size)
+{
+    return map_create_sized(0, value_size, 0);
+}
+
+// the largest power of two dividing size, capped at the strictest alignment malloc guarantees
+static size_t map_natural_align(size_t size)
+{
+    size_t align = size & (~size + 1);
+    return align < _Alignof(max_align_t) ? align : _Alignof(max_align_t);
+}
+
+// a key_size of 0 marks a map of variable-length keys
+// up to MAP_SMALL_MAX_ENTRIES the map starts small (and allocates nothing for a capacity of 0);
+// beyond that it starts as a robin hood table that holds capacity entries without growing
+static map_t *map_create_sized(size_t key_size, size_t value_size, size_t capacity)
+{
+    if (!value_size)
+    {
+        return NULL;
     }
 
-    stack_t *allocated = map->allocated;
-    dyn_arr_t *arr = map->arr;
+    map_t *map = (map_t *)malloc(sizeof(map_t));
+    if (!map)
+    {
+        return NULL;
+    }
 
-    if (allocated->stack_size >= BUCKET_DOUBLING_CUTOFF * map->curr_max_len)
+    // key and value sit right after the header, each at the alignment its size implies,
+    // so a 4-byte key and value make a 24-byte slot
+    size_t stored_key_size = key_size ? key_size : sizeof(void *);
+    size_t value_align = map_natural_align(value_size);
+    size_t slot_align = _Alignof(map_slot_t);
+    if (value_align > slot_align)
     {
-        // double the number of nodes (same as doubling the places in the array) in the dynamic array and rehash
-        map->curr_max_len <<= 1U;
-        if (!rehash(map))
+        slot_align = value_align;
+    }
+
+    map->key_offset = sizeof(map_slot_t);
+    map->value_offset = ALIGN_UP(map->key_offset + stored_key_size, value_align);
+    map->slot_size = ALIGN_UP(map->value_offset + value_size, slot_align);
+
+    size_t len = 0;
+    map->is_small = capacity <= MAP_SMALL_MAX_ENTRIES;
+    if (map->is_small)
+    {
+        while (len < capacity)
         {
-            map->curr_max_len >>= 1U;
-            return false;
+            len = len ? len * 2 : MAP_SMALL_MIN_LEN;
+        }
+    }
+    else
+    {
+        len = MAP_HASHED_MIN_LEN;
+        while (capacity > BUCKET_DOUBLING_CUTOFF * len)
+        {
+            len <<= 1U;
         }
-        // critical, change the allocated variable after rehashing since the stack changes during rehashing
-        // this was causing the  key pushed during rehashing to be lost
-        // it was pushed into the wrong allocated table
+    }
 
-        allocated = map->allocated;
+    // slot_size is fixed for the map's lifetime, so the scratch slot is sized once here
+    map->scratch = malloc(map->slot_size);
+    if (!map->scratch)
+    {
+        free(map);
+        return NULL;
     }
 
-    size_t hash = (size_t)xxh32(key, map->key_size) & (map->curr_max_len - 1);
-    size_t original_hash = hash;
+    map->slots = NULL;
+    if (len)
+    {
+        map->slots = calloc(len, map->slot_size);
+        if (!map->slots)
+        {
+            free(map->scratch);
+            free(map);
+            return NULL;
+        }
+    }
 
-    map_node_t node;
+    map->key_size = key_size;
+    map->value_size = value_size;
+    map->curr_max_len = len;
+    map->num_of_entries = 0;
+    map->hash_fn = HASH_FN_DEFAULT;
+    map->seed = HASH_DEFAULT_SEED;
 
-    while (true)
+    return map;
+}
+
+bool map_destroy(map_t *map)
+{
+    if (!map || !map->value_size)
     {
-        if (!dyn_arr_get(arr, hash, &node))
+        return false;
+    }
+
+    if (!map->key_size)
+    {
+        for (size_t index = 0; index < map->curr_max_len; index++)
         {
-            // the dynamic array node containing the index hash is not allocated yet
-            node.key = malloc(map->key_size);
-            if (!node.key)
+            const map_slot_t *slot = map_slot(map, index);
+            if (slot->used)
             {
-                return false;
+                map_slot_free_key(map, slot);
             }
+        }
+    }
 
-            if (!memcpy(node.key, key, map->key_size))
-            {
-                free(node.key);
-                return false;
-            }
+    free(map->slots);
+    free(map->scratch);
+    free(map);
+    return true;
+}
 
-            node.value = malloc(map->value_size);
-            if (!node.value)
-            {
-                free(node.key);
-                return false;
-            }
+// hashes a group of keys and prefetches each home slot before probing any of them
+// keys and values are inline, so the home slot is the only line a short probe touches
+static void map_prefetch_group(map_t *map, const uint8_t *keys, size_t len, uint64_t *hashes)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        hashes[i] = map_hash(map, keys + i * map->key_size, map->key_size);
+        PREFETCH(map_slot(map, hashes[i] & (map->curr_max_len - 1)));
+    }
+}
 
-            if (!memcpy(node.value, value, map->value_size))
-            {
-                free(node.key);
-                free(node.value);
-                return false;
-            }
+size_t map_search_batch(map_t *map, const void *keys, size_t count, void *values, bool *found)
+{
+    if (!map || !keys || !map->key_size)
+    {
+        return 0;
+    }
 
-            node.is_empty = false;
+    const uint8_t *key_bytes = (const uint8_t *)keys;
+    uint8_t *value_bytes = (uint8_t *)values;
+    uint64_t hashes[BATCH_GROUP];
+    size_t hits = 0;
 
-            // dyn_arr_set will copy the contents of the map_node node into the index hash
-            // it will copy the pointers key and value and won't allocate them and save their values
-            // so, we do this before inserting the node into the array
-            // these will be freed when the map is destroyed
-            if (!dyn_arr_set(arr, hash, &node))
-            {
-                free(node.key);
-                free(node.value);
-                return false;
-            }
+    for (size_t start = 0; start < count; start += BATCH_GROUP)
+    {
+        size_t len = count - start < BATCH_GROUP ? count - start : BATCH_GROUP;
 
-            if (!stack_push(allocated, &hash))
+        if (map->is_small)
+        {
+            // a small map is never hashed, so there is nothing to prefetch
+            for (size_t i = start; i < start + len; i++)
             {
-                free(node.key);
-                free(node.value);
-                return false;
+                bool hit = map_search_var(map, (void *)(key_bytes + i * map->key_size), map->key_size,
+                                          value_bytes ? value_bytes + i * map->value_size : NULL);
+                hits += hit;
+                if (found)
+                {
+                    found[i] = hit;
+                }
             }
-
-            return true;
+            continue;
         }
 
-        if (node.is_empty)
-        {
-            // empty place found, but key and value pointers may not be allocated
-            // need to allocate memory for key and value
+        map_prefetch_group(map, key_bytes + start * map->key_size, len, hashes);
 
-            // if pointers are NULL, allocate new memory
-            if (!node.key)
+        for (size_t i = 0; i < len; i++)
+        {
+            const void *stored = map_lookup(map, key_bytes + (start + i) * map->key_size, map->key_size, hashes[i]);
+            if (stored)
             {
-                node.key = malloc(map->key_size);
-                if (!node.key)
+                if (value_bytes)
                 {
-                    return false;
+                    memcpy(value_bytes + (start + i) * map->value_size, stored, map->value_size);
                 }
+                hits++;
             }
 
-            if (!node.value)
+            if (found)
             {
-                node.value = malloc(map->value_size);
-                if (!node.value)
-                {
-                    // free key if it was just allocated
-                    free(node.key);
-                    return false;
-                }
+                found[start + i] = stored != NULL;
             }
+        }
+    }
 
-            node.is_empty = false;
+    return hits;
+}
 
-            if (!memcpy(node.key, key, map->key_size))
-            {
-                return false;
-            }
+bool map_insert_batch(map_t *map, const void *keys, const void *values, size_t count)
+{
+    if (!map || !keys || !values || !map->key_size)
+    {
+        return false;
+    }
 
-            if (!memcpy(node.value, value, map->value_size))
-            {
-                return false;
-            }
+    const uint8_t *key_bytes = (const uint8_t *)keys;
+    const uint8_t *value_bytes = (const uint8_t *)values;
+    uint64_t hashes[BATCH_GROUP];
 
-            if (!dyn_arr_set(arr, hash, &node))
-            {
-                return false;
-            }
+    for (size_t start = 0; start < count; start += BATCH_GROUP)
+    {
+        size_t len = count - start < BATCH_GROUP ? count - start : BATCH_GROUP;
 
-            if (!stack_push(allocated, &hash))
+        if (map->is_small)
+        {
+            // a small map is never hashed; it turns into a robin hood table partway through the group if it must
+            for (size_t i = start; i < start + len; i++)
             {
-                return false;
+                if (!map_insert_var(map, (void *)(key_bytes + i * map->key_size), map->key_size,
+                                    (void *)(value_bytes + i * map->value_size)))
+                {
+                    return false;
+                }
             }
-
-            return true;
+            continue;
         }
 
-        // check if the key already exists
-        if (!memcmp(node.key, key, map->key_size))
+        map_prefetch_group(map, key_bytes + start * map->key_size, len, hashes);
+
+        for (size_t i = 0; i < len; i++)
         {
-            // update existing key's value
-            if (!memcpy(node.value, value, map->value_size))
+            // map_insert_with_hash masks the full hash itself, so a rehash partway through the group is fine
+            if (!map_insert_with_hash(map, key_bytes + (start + i) * map->key_size, map->key_size,
+                                      value_bytes + (start + i) * map->value_size, hashes[i]))
             {
                 return false;
             }
+        }
+    }
 
-            if (!dyn_arr_set(arr, hash, &node))
-            {
-                return false;
-            }
+    return true;
+}
 
-            return true;
-        }
+bool map_foreach(map_t *map, map_visit_fn visit, void *ctx)
+{
+    if (!map || !visit)
+    {
+        return false;
+    }
 
-        hash = (hash + 1) & (map->curr_max_len - 1); // linear probing
-        if (hash == original_hash)
+    // small or hashed, every live entry is a used slot below curr_max_len
+    for (size_t index = 0; index < map->curr_max_len; index++)
+    {
+        map_slot_t *slot = map_slot(map, index);
+        if (slot->used && !visit(map_slot_key(map, slot), slot->key_len, map_slot_value(map, slot), ctx))
         {
-            // hash table is full (should not happen with rehashing)
             return false;
         }
     }
 
-    return false;
+    return true;
 }
 
-map_t *map_create(size_t key_size, size_t value_size)
+void map_iter_init(map_iter_t *iter, map_t *map)
 {
-    if (!key_size || !value_size)
-    {
-        return NULL;
-    }
+    iter->map = map;
+    iter->index = 0;
+}
 
-    map_t *map = (map_t *)malloc(sizeof(map_t));
+bool map_iter_next(map_iter_t *iter, const void **key, size_t *key_len, void **value)
+{
+    map_t *map = iter->map;
     if (!map)
     {
-        return NULL;
+        return false;
     }
 
-#define INIT_DYN_LEN (1U << 10) // can't be zero; must be a power of two
+    for (; iter->index < map->curr_max_len; iter->index++)
+    {
+        map_slot_t *slot = map_slot(map, iter->index);
+        if (!slot->used)
+        {
+            continue;
+        }
+
+        if (key)
+        {
+            *key = map_slot_key(map, slot);
+        }
+        if (key_len)
+        {
+            *key_len = slot->key_len;
+        }
+        if (value)
+        {
+            *value = map_slot_value(map, slot);
+        }
+
+        iter->index++;
+        return true;
+    }
 
-    map_node_t default_node;
-    default_node.is_empty = true;
-    default_node.key = NULL;
-    default_node.value = NULL;
+    return false;
+}
 
-    map->arr = dyn_arr_create(INIT_DYN_LEN, sizeof(map_node_t), &default_node);
-    if (!map->arr)
+// the cursor names a home slot rather than a physical one: inserts and backward-shift removes move entries
+// between slots, but an entry's home only changes when the map doubles, and then in the way hash_scan_next expects
+// robin hood order keeps the entries of one home in a single run, found with the same walk as a lookup
+uint64_t map_scan(map_t *map, uint64_t cursor, size_t count, map_scan_fn visit, void *ctx)
+{
+    if (!map || !visit)
     {
-        free(map);
-        return NULL;
+        return 0;
     }
 
-    map->allocated = stack_create(sizeof(size_t));
-    if (!map->allocated)
+    if (map->is_small)
     {
-        dyn_arr_free(map->arr);
-        free(map);
-        return NULL;
+        // a small map is unhashed and never comes back once it is hashed, so it goes in one call
+        for (size_t index = 0; index < map->num_of_entries; index++)
+        {
+            map_slot_t *slot = map_slot(map, index);
+            visit(map_slot_key(map, slot), slot->key_len, map_slot_value(map, slot), ctx);
+        }
+        return 0;
     }
 
-    map->key_size = key_size;
-    map->value_size = value_size;
-    map->curr_max_len = INIT_DYN_LEN;
+    size_t mask = map->curr_max_len - 1;
+    size_t visited = 0;
 
-    return map;
+    do
+    {
+        size_t home = (size_t)cursor & mask;
+
+        for (size_t dist = 0;; dist++)
+        {
+            size_t index = (home + dist) & mask;
+            map_slot_t *slot = map_slot(map, index);
+            if (!slot->used)
+            {
+                break;
+            }
+
+            size_t slot_dist = map_probe_dist(map, index, slot->hash);
+            if (slot_dist < dist)
+            {
+                break; // past the end of home's run
+            }
+            if (slot_dist == dist)
+            {
+                visit(map_slot_key(map, slot), slot->key_len, map_slot_value(map, slot), ctx);
+                visited++;
+            }
+        }
+
+        cursor = hash_scan_next(cursor, mask);
+    } while (cursor && visited < count);
+
+    return cursor;
 }
 
-bool map_destroy(map_t *map)
+bool map_save(map_t *map, const char *path)
 {
-    if (!map || !map->allocated || !map->arr || !map->key_size || !map->value_size)
+    if (!map || !path)
     {
         return false;
     }
 
-    size_t index;
-    map_node_t node;
-    size_t len = map->allocated->stack_size;
-
-    for (size_t counter = 0; counter < len; counter++)
+    // variable-length keys go in their own region, so its size has to be known before the file is laid out
+    size_t key_bytes = 0;
+    if (!map->key_size)
     {
-        if (!stack_pop(map->allocated, &index))
+        for (size_t index = 0; index < map->curr_max_len; index++)
         {
-            break;
+            key_bytes += map_slot(map, index)->key_len;
         }
+    }
+
+    snapshot_writer_t writer;
+    if (!snapshot_writer_open(&writer, path, map->key_size, map->value_size, map->num_of_entries, key_bytes, map->hash_fn, map->seed))
+    {
+        return false;
+    }
 
-        if (!dyn_arr_get(map->arr, index, &node))
+    bool ok = true;
+    for (size_t index = 0; ok && index < map->curr_max_len; index++)
+    {
+        map_slot_t *slot = map_slot(map, index);
+        if (!slot->used)
         {
-            break;
+            continue;
         }
 
-        free(node.key);
-        free(node.value);
+        const void *key = map_slot_key(map, slot);
+        // small maps never hash their entries, so only they pay for it here
+        uint64_t full_hash = map->is_small ? map_hash(map, key, slot->key_len) : slot->hash;
+        ok = snapshot_writer_add(&writer, key, slot->key_len, map_slot_value(map, slot), full_hash);
     }
 
-    if (!stack_delete(map->allocated))
+    return snapshot_writer_close(&writer, path, ok);
+}
+
+bool map_set_hash_fn(map_t *map, hash_fn_t hash_fn, uint64_t seed)
+{
+    if (!map || !hash_fn || map->num_of_entries)
     {
         return false;
     }
 
-    dyn_arr_free(map->arr);
-    free(map);
+    map->hash_fn = hash_fn;
+    map->seed = seed;
     return true;
-}
\ No newline at end of file
+}
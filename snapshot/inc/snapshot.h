@@ -0,0 +1,104 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../hash/inc/hash.h"
+
+#define SNAPSHOT_MAGIC (0x50414e5348534148ULL) // "HASHSNAP" read as a little-endian uint64_t
+#define SNAPSHOT_VERSION (1U)
+#define SNAPSHOT_BYTE_ORDER (0x01020304U) // reads back differently on a machine of the other endianness
+
+#define SNAPSHOT_MIN_SLOTS (16U)
+#define SNAPSHOT_SLOTS_ALIGN (64U) // the slot array starts on a cache line (and the keys region after it)
+
+// ids of the built-in hash functions, so a file records which one its hashes came from
+#define SNAPSHOT_HASH_CUSTOM (0U)
+#define SNAPSHOT_HASH_WYHASH (1U)
+#define SNAPSHOT_HASH_CRC32C (2U)
+#define SNAPSHOT_HASH_MURMUR3 (3U)
+#define SNAPSHOT_HASH_XXH32 (4U)
+
+// on-disk layout: this header, then num_of_slots fixed-stride slots at slots_offset, then (for variable-length
+// keys) every key's bytes back to back at keys_offset; nothing in the file is a pointer, so it can be mapped
+// anywhere and searched in place
+// the slots are a robin hood table in map_t's layout: a 16-byte header (full hash, key length, used), the key
+// bytes (or, for variable-length keys, a uint64_t offset into the keys region), then the value bytes
+typedef struct
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t hash_id; // SNAPSHOT_HASH_*; a custom hash function has to be handed to snapshot_open
+    uint32_t reserved;
+    uint64_t seed;
+    uint64_t key_size; // 0 for variable-length keys
+    uint64_t value_size;
+    uint64_t slot_size;
+    uint64_t key_offset;   // offset of the key field inside a slot
+    uint64_t value_offset; // offset of the value bytes inside a slot
+    uint64_t num_of_slots; // always a power of two
+    uint64_t num_of_entries;
+    uint64_t slots_offset;
+    uint64_t keys_offset;
+    uint64_t keys_bytes;
+    uint64_t file_size;
+} snapshot_header_t;
+
+typedef struct
+{
+    uint64_t hash;
+    uint32_t key_len;
+    uint32_t used;
+} snapshot_slot_t;
+
+// a snapshot file mapped read-only; lookups read the mapping directly and never copy the table
+typedef struct
+{
+    const uint8_t *base; // the whole file
+    size_t size;
+    const snapshot_header_t *header;
+    const uint8_t *slots;
+    const uint8_t *keys;
+    hash_fn_t hash_fn;
+} snapshot_t;
+
+// builds a snapshot file by placing entries straight into a writable mapping of it, so saving a table needs
+// no second copy of it in memory; the entry count and total key bytes must be known up front
+// the file is written under a temporary name in the target's directory and only renamed over the target once
+// it is complete and synced, so readers of the old snapshot are never disturbed and a failed save loses nothing
+typedef struct
+{
+    int fd;
+    char *tmp_path; // the file being written; renamed over the target by snapshot_writer_close
+    uint8_t *base;
+    size_t size;
+    snapshot_header_t *header;
+    uint8_t *slots;
+    uint8_t *keys;
+    size_t keys_used;
+    size_t num_of_entries; // entries the file was sized for
+} snapshot_writer_t;
+
+// key_size of 0 means variable-length keys whose lengths add up to key_bytes (ignored otherwise)
+bool snapshot_writer_open(snapshot_writer_t *writer, const char *path, size_t key_size, size_t value_size, size_t num_of_entries,
+                          size_t key_bytes, hash_fn_t hash_fn, uint64_t seed);
+// adds an entry whose key is not in the file yet; full_hash is hash_fn(key) with the seed given to open
+bool snapshot_writer_add(snapshot_writer_t *writer, const void *key, size_t key_len, const void *value, uint64_t full_hash);
+// writes the header, syncs the file and renames it over path; on failure (or with ok false, to abandon a half-written
+// file) the temporary file is removed and path is left as it was
+bool snapshot_writer_close(snapshot_writer_t *writer, const char *path, bool ok);
+
+// maps a snapshot file and checks its header; hash_fn may be NULL for files written with a built-in hash function,
+// and is required for files written with a custom one; a hash_fn other than the one the file records is refused
+snapshot_t *snapshot_open(const char *path, hash_fn_t hash_fn);
+void snapshot_close(snapshot_t *snapshot);
+
+// returns a pointer to key's value inside the mapping, or NULL if key is missing; good until snapshot_close
+const void *snapshot_get_ptr(const snapshot_t *snapshot, const void *key, size_t key_len);
+bool snapshot_search(const snapshot_t *snapshot, const void *key, size_t key_len, void *value); // value may be NULL
+size_t snapshot_size(const snapshot_t *snapshot);
+
+#endif
@@ -0,0 +1,416 @@
+#include "../inc/snapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SNAPSHOT_TMP_SUFFIX ".tmp.XXXXXX" // mkstemp template appended to the target path
+#define SNAPSHOT_FILE_MODE (0644)          // mkstemp creates files 0600
+
+#define SNAPSHOT_LOAD_FACTOR (0.8) // same cutoff as map_t, so probe runs stay as short as in memory
+
+#define SLOT_ALIGN (_Alignof(max_align_t))
+
+#define ALIGN_UP(x, a) (((x) + ((a) - 1)) & ~((size_t)(a) - 1))
+
+static const struct
+{
+    hash_fn_t fn;
+    uint32_t id;
+} snapshot_hashes[] = {
+    {hash_fn_wyhash, SNAPSHOT_HASH_WYHASH},
+    {hash_fn_crc32c, SNAPSHOT_HASH_CRC32C},
+    {hash_fn_murmur3, SNAPSHOT_HASH_MURMUR3},
+    {hash_fn_xxh32, SNAPSHOT_HASH_XXH32},
+};
+
+#define SNAPSHOT_NUM_HASHES (sizeof(snapshot_hashes) / sizeof(snapshot_hashes[0]))
+
+static uint32_t snapshot_hash_id(hash_fn_t fn)
+{
+    for (size_t index = 0; index < SNAPSHOT_NUM_HASHES; index++)
+    {
+        if (snapshot_hashes[index].fn == fn)
+            return snapshot_hashes[index].id;
+    }
+    return SNAPSHOT_HASH_CUSTOM;
+}
+
+static hash_fn_t snapshot_hash_fn(uint32_t id)
+{
+    for (size_t index = 0; index < SNAPSHOT_NUM_HASHES; index++)
+    {
+        if (snapshot_hashes[index].id == id)
+            return snapshot_hashes[index].fn;
+    }
+    return NULL;
+}
+
+// the largest power of two dividing size, capped at SLOT_ALIGN
+static size_t snapshot_natural_align(size_t size)
+{
+    size_t align = size & (~size + 1);
+    return align < SLOT_ALIGN ? align : SLOT_ALIGN;
+}
+
+static inline const snapshot_slot_t *snapshot_slot(const uint8_t *slots, const snapshot_header_t *header, size_t index)
+{
+    return (const snapshot_slot_t *)(slots + index * header->slot_size);
+}
+
+// how far the entry in slot index sits from its home slot
+static inline size_t snapshot_probe_dist(const snapshot_header_t *header, size_t index, uint64_t full_hash)
+{
+    size_t mask = header->num_of_slots - 1;
+    return (index - ((size_t)full_hash & mask)) & mask;
+}
+
+bool snapshot_writer_open(snapshot_writer_t *writer, const char *path, size_t key_size, size_t value_size, size_t num_of_entries,
+                          size_t key_bytes, hash_fn_t hash_fn, uint64_t seed)
+{
+    if (!writer || !path || !value_size || !hash_fn)
+        return false;
+
+    if (key_size)
+        key_bytes = 0;
+
+    size_t num_of_slots = SNAPSHOT_MIN_SLOTS;
+    while (num_of_entries > SNAPSHOT_LOAD_FACTOR * num_of_slots)
+        num_of_slots <<= 1U;
+
+    // a variable-length key is an offset into the keys region, so its slot field is always 8 bytes
+    size_t key_field = key_size ? key_size : sizeof(uint64_t);
+    size_t value_align = snapshot_natural_align(value_size);
+    size_t key_offset = sizeof(snapshot_slot_t);
+    size_t value_offset = ALIGN_UP(key_offset + key_field, value_align);
+    size_t slot_size = ALIGN_UP(value_offset + value_size, value_align > sizeof(uint64_t) ? value_align : sizeof(uint64_t));
+
+    size_t slots_offset = ALIGN_UP(sizeof(snapshot_header_t), SNAPSHOT_SLOTS_ALIGN);
+    size_t keys_offset = ALIGN_UP(slots_offset + num_of_slots * slot_size, SNAPSHOT_SLOTS_ALIGN);
+    size_t size = keys_offset + key_bytes;
+
+    // the file is built under a temporary name next to path and renamed over it by snapshot_writer_close, so
+    // path keeps its old snapshot (and anyone who has it mapped keeps a valid mapping) until the new one is done
+    size_t path_len = strlen(path);
+    char *tmp_path = malloc(path_len + sizeof(SNAPSHOT_TMP_SUFFIX));
+    if (!tmp_path)
+        return false;
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, SNAPSHOT_TMP_SUFFIX, sizeof(SNAPSHOT_TMP_SUFFIX));
+
+    int fd = mkstemp(tmp_path);
+    if (fd < 0)
+    {
+        free(tmp_path);
+        return false;
+    }
+
+    // ftruncate zero-fills, so every slot starts out unused without being written
+    uint8_t *base = NULL;
+    if (fchmod(fd, SNAPSHOT_FILE_MODE) || ftruncate(fd, (off_t)size) ||
+        (base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        unlink(tmp_path);
+        free(tmp_path);
+        return false;
+    }
+
+    writer->fd = fd;
+    writer->tmp_path = tmp_path;
+    writer->base = base;
+    writer->size = size;
+    writer->header = (snapshot_header_t *)base;
+    writer->slots = base + slots_offset;
+    writer->keys = base + keys_offset;
+    writer->keys_used = 0;
+    writer->num_of_entries = num_of_entries;
+
+    // the magic is written last, by snapshot_writer_close, so a file cut short is never taken for a snapshot
+    snapshot_header_t *header = writer->header;
+    header->version = SNAPSHOT_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->hash_id = snapshot_hash_id(hash_fn);
+    header->reserved = 0;
+    header->seed = seed;
+    header->key_size = key_size;
+    header->value_size = value_size;
+    header->slot_size = slot_size;
+    header->key_offset = key_offset;
+    header->value_offset = value_offset;
+    header->num_of_slots = num_of_slots;
+    header->num_of_entries = 0;
+    header->slots_offset = slots_offset;
+    header->keys_offset = keys_offset;
+    header->keys_bytes = key_bytes;
+    header->file_size = size;
+
+    return true;
+}
+
+// robin hood placement, as map_place does it: the entry takes the first slot that is empty or holds an entry
+// closer to its home, and the run from there to the next empty slot shifts forward by one
+bool snapshot_writer_add(snapshot_writer_t *writer, const void *key, size_t key_len, const void *value, uint64_t full_hash)
+{
+    snapshot_header_t *header = writer->header;
+
+    if (header->num_of_entries >= writer->num_of_entries)
+        return false;
+    if (header->key_size ? key_len != header->key_size : (key_len > UINT32_MAX || key_len > header->keys_bytes - writer->keys_used))
+        return false;
+
+    size_t mask = header->num_of_slots - 1;
+    size_t index = (size_t)full_hash & mask;
+
+    for (size_t dist = 0;; dist++)
+    {
+        const snapshot_slot_t *slot = snapshot_slot(writer->slots, header, index);
+        if (!slot->used || snapshot_probe_dist(header, index, slot->hash) < dist)
+            break;
+        index = (index + 1) & mask;
+    }
+
+    size_t target = index;
+    while (snapshot_slot(writer->slots, header, index)->used)
+        index = (index + 1) & mask;
+
+    while (index != target)
+    {
+        size_t prev = (index - 1) & mask;
+        memcpy(writer->slots + index * header->slot_size, writer->slots + prev * header->slot_size, header->slot_size);
+        index = prev;
+    }
+
+    uint8_t *dst = writer->slots + target * header->slot_size;
+    memset(dst, 0, header->slot_size);
+
+    snapshot_slot_t *slot = (snapshot_slot_t *)dst;
+    slot->hash = full_hash;
+    slot->key_len = (uint32_t)key_len;
+    slot->used = 1;
+
+    if (header->key_size)
+    {
+        memcpy(dst + header->key_offset, key, key_len);
+    }
+    else
+    {
+        uint64_t key_pos = writer->keys_used;
+        memcpy(writer->keys + key_pos, key, key_len);
+        memcpy(dst + header->key_offset, &key_pos, sizeof(key_pos));
+        writer->keys_used += key_len;
+    }
+
+    memcpy(dst + header->value_offset, value, header->value_size);
+
+    header->num_of_entries++;
+    return true;
+}
+
+// makes a rename in path's directory durable; a failure here is not fatal, the new file is in place either way
+static void snapshot_sync_dir(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    int fd;
+
+    if (!slash)
+    {
+        fd = open(".", O_RDONLY | O_DIRECTORY);
+    }
+    else
+    {
+        size_t len = slash == path ? 1 : (size_t)(slash - path);
+        char *dir = malloc(len + 1);
+        if (!dir)
+            return;
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+        fd = open(dir, O_RDONLY | O_DIRECTORY);
+        free(dir);
+    }
+
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+bool snapshot_writer_close(snapshot_writer_t *writer, const char *path, bool ok)
+{
+    // the data has to be on disk before the rename publishes it, or a crash could leave path naming a torn file
+    if (ok)
+    {
+        writer->header->magic = SNAPSHOT_MAGIC;
+        ok = !msync(writer->base, writer->size, MS_SYNC) && !fsync(writer->fd);
+    }
+
+    munmap(writer->base, writer->size);
+    close(writer->fd);
+
+    // only the temporary file is ever removed; on failure path still holds whatever it held before
+    if (ok)
+        ok = path && !rename(writer->tmp_path, path);
+    if (ok)
+        snapshot_sync_dir(path);
+    else
+        unlink(writer->tmp_path);
+
+    free(writer->tmp_path);
+    writer->tmp_path = NULL;
+    return ok;
+}
+
+// every offset and size in the header is checked against the file, so a damaged file is refused
+// instead of letting a lookup read past the mapping
+static bool snapshot_header_ok(const snapshot_header_t *header, size_t size)
+{
+    if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION || header->byte_order != SNAPSHOT_BYTE_ORDER)
+        return false;
+    if (header->file_size != size || !header->value_size)
+        return false;
+
+    size_t key_field = header->key_size ? header->key_size : sizeof(uint64_t);
+    if (header->key_offset < sizeof(snapshot_slot_t) || header->value_offset < header->key_offset + key_field ||
+        header->slot_size < header->value_offset + header->value_size || header->slot_size % sizeof(uint64_t))
+        return false;
+
+    uint64_t num_of_slots = header->num_of_slots;
+    if (!num_of_slots || (num_of_slots & (num_of_slots - 1)) || header->num_of_entries >= num_of_slots)
+        return false;
+
+    if (header->slots_offset < sizeof(snapshot_header_t) || header->slots_offset % SNAPSHOT_SLOTS_ALIGN ||
+        header->slots_offset > size || num_of_slots > (size - header->slots_offset) / header->slot_size)
+        return false;
+
+    if (header->keys_offset < header->slots_offset + num_of_slots * header->slot_size || header->keys_offset > size ||
+        header->keys_bytes > size - header->keys_offset)
+        return false;
+
+    return true;
+}
+
+snapshot_t *snapshot_open(const char *path, hash_fn_t hash_fn)
+{
+    if (!path)
+        return NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(snapshot_header_t))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    uint8_t *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if (base == MAP_FAILED)
+        return NULL;
+
+    // the caller's function has to be the one the file was written with: a built-in is known by its id, and
+    // only a file that records a custom hash takes a function from the caller (which has to supply one)
+    const snapshot_header_t *header = (const snapshot_header_t *)base;
+    if (!hash_fn)
+        hash_fn = snapshot_hash_fn(header->hash_id);
+    else if (snapshot_hash_id(hash_fn) != header->hash_id)
+        hash_fn = NULL;
+
+    snapshot_t *snapshot = malloc(sizeof(snapshot_t));
+    if (!snapshot || !hash_fn || !snapshot_header_ok(header, size))
+    {
+        free(snapshot);
+        munmap(base, size);
+        return NULL;
+    }
+
+    // probes land all over the slot array, so read-ahead would mostly fetch pages nobody asked for
+    madvise(base, size, MADV_RANDOM);
+
+    snapshot->base = base;
+    snapshot->size = size;
+    snapshot->header = header;
+    snapshot->slots = base + header->slots_offset;
+    snapshot->keys = base + header->keys_offset;
+    snapshot->hash_fn = hash_fn;
+    return snapshot;
+}
+
+void snapshot_close(snapshot_t *snapshot)
+{
+    if (!snapshot)
+        return;
+
+    munmap((void *)snapshot->base, snapshot->size);
+    free(snapshot);
+}
+
+static inline bool snapshot_key_equals(const snapshot_t *snapshot, const snapshot_slot_t *slot, const void *key, size_t key_len)
+{
+    const snapshot_header_t *header = snapshot->header;
+    const uint8_t *field = (const uint8_t *)slot + header->key_offset;
+
+    if (slot->key_len != key_len)
+        return false;
+    if (header->key_size)
+        return !memcmp(field, key, key_len);
+
+    uint64_t key_pos;
+    memcpy(&key_pos, field, sizeof(key_pos));
+    if (key_pos > header->keys_bytes || key_len > header->keys_bytes - key_pos)
+        return false;
+    return !memcmp(snapshot->keys + key_pos, key, key_len);
+}
+
+// the same walk as map_find: stop at an empty slot or at one closer to its home than the probe is to key's
+const void *snapshot_get_ptr(const snapshot_t *snapshot, const void *key, size_t key_len)
+{
+    if (!snapshot || !key)
+        return NULL;
+
+    const snapshot_header_t *header = snapshot->header;
+    if (header->key_size && key_len != header->key_size)
+        return NULL;
+
+    uint64_t full_hash = snapshot->hash_fn(key, key_len, header->seed);
+    size_t mask = header->num_of_slots - 1;
+    size_t index = (size_t)full_hash & mask;
+
+    for (size_t dist = 0; dist <= mask; dist++)
+    {
+        const snapshot_slot_t *slot = snapshot_slot(snapshot->slots, header, index);
+        if (!slot->used || snapshot_probe_dist(header, index, slot->hash) < dist)
+            return NULL;
+
+        if (slot->hash == full_hash && snapshot_key_equals(snapshot, slot, key, key_len))
+            return (const uint8_t *)slot + header->value_offset;
+
+        index = (index + 1) & mask;
+    }
+
+    return NULL;
+}
+
+bool snapshot_search(const snapshot_t *snapshot, const void *key, size_t key_len, void *value)
+{
+    const void *stored = snapshot_get_ptr(snapshot, key, key_len);
+    if (!stored)
+        return false;
+
+    if (value)
+        memcpy(value, stored, snapshot->header->value_size);
+    return true;
+}
+
+size_t snapshot_size(const snapshot_t *snapshot)
+{
+    return snapshot ? snapshot->header->num_of_entries : 0;
+}
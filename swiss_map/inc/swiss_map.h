@@ -0,0 +1,51 @@
+#ifndef SWISS_MAP_H
+#define SWISS_MAP_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../../hash/inc/hash.h"
+
+#define SWISS_MAP_GROUP_WIDTH (16U) // control tags matched per probe step, one SSE2 register
+#define SWISS_MAP_MIN_CAPACITY (SWISS_MAP_GROUP_WIDTH)
+
+// one control tag per slot: a full slot holds the low 7 bits of its key's hash (h2),
+// the other two states have the top bit set so a single movemask finds them
+#define SWISS_MAP_CTRL_EMPTY ((uint8_t)0x80)
+#define SWISS_MAP_CTRL_DELETED ((uint8_t)0xFE)
+
+typedef struct
+{
+    uint8_t *ctrl;   // capacity + SWISS_MAP_GROUP_WIDTH tags; the tail mirrors the first group so every group load stays in bounds
+    uint8_t *slots;  // capacity fixed-stride slots, key bytes then value bytes, in the same allocation as ctrl
+    size_t capacity; // always a power of two, never below SWISS_MAP_MIN_CAPACITY
+    size_t size;     // full slots
+    size_t growth_left; // EMPTY slots that may still be filled before the load factor (7/8) is reached
+    size_t key_size;
+    size_t value_size;
+    size_t value_offset; // offset of the value bytes inside a slot
+    size_t slot_size;
+    hash_fn_t hash_fn; // probing starts at group (hash >> 7) & (capacity - 1); the low 7 bits become the tag
+    uint64_t seed;
+} swiss_map_t;
+
+// open-addressing map with the semantics of map_t, probed 16 tags at a time
+// keys and values are stored inline, so a probe that matches no tag never touches slot memory
+swiss_map_t *swiss_map_create(size_t key_size, size_t value_size); // key and value size in bytes
+void swiss_map_destroy(swiss_map_t *map);
+
+// swaps in another hash function (HASH_FN_DEFAULT is used otherwise); only allowed while the map is empty
+bool swiss_map_set_hash_fn(swiss_map_t *map, hash_fn_t hash_fn, uint64_t seed);
+
+bool swiss_map_insert(swiss_map_t *map, const void *key, const void *value); // overwrites the value of an existing key
+bool swiss_map_remove(swiss_map_t *map, const void *key);
+bool swiss_map_search(swiss_map_t *map, const void *key, void *value); // value may be NULL to only test membership
+
+// returns a pointer to key's value inside the map, or NULL if key is missing
+// an insert may rebuild the table and move every slot, so the pointer is only good until the next insert
+// (or until key is removed)
+const void *swiss_map_get_ptr(swiss_map_t *map, const void *key);
+size_t swiss_map_size(const swiss_map_t *map);
+
+#endif
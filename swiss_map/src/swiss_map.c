@@ -0,0 +1,340 @@
+#include "../inc/swiss_map.h"
+
+#include <string.h>
+#include <stddef.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define SLOT_ALIGN (_Alignof(max_align_t))
+
+#define ALIGN_UP(x, a) (((x) + ((a) - 1)) & ~((size_t)(a) - 1))
+
+static inline uint64_t swiss_map_hash(const swiss_map_t *map, const void *key)
+{
+    return map->hash_fn(key, map->key_size, map->seed);
+}
+
+static inline size_t swiss_h1(uint64_t hash)
+{
+    return (size_t)(hash >> 7);
+}
+
+static inline uint8_t swiss_h2(uint64_t hash)
+{
+    return (uint8_t)(hash & 0x7F);
+}
+
+// the three group matchers return one bit per tag, bit i for ctrl[i]
+#ifdef __SSE2__
+
+static inline uint32_t swiss_group_match(const uint8_t *ctrl, uint8_t h2)
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+}
+
+static inline uint32_t swiss_group_match_empty(const uint8_t *ctrl)
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)SWISS_MAP_CTRL_EMPTY)));
+}
+
+// EMPTY and DELETED are the only tags with the top bit set
+static inline uint32_t swiss_group_match_empty_or_deleted(const uint8_t *ctrl)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+
+#else
+
+static inline uint32_t swiss_group_match(const uint8_t *ctrl, uint8_t h2)
+{
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < SWISS_MAP_GROUP_WIDTH; i++)
+        mask |= (uint32_t)(ctrl[i] == h2) << i;
+    return mask;
+}
+
+static inline uint32_t swiss_group_match_empty(const uint8_t *ctrl)
+{
+    return swiss_group_match(ctrl, SWISS_MAP_CTRL_EMPTY);
+}
+
+static inline uint32_t swiss_group_match_empty_or_deleted(const uint8_t *ctrl)
+{
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < SWISS_MAP_GROUP_WIDTH; i++)
+        mask |= (uint32_t)(ctrl[i] >> 7) << i;
+    return mask;
+}
+
+#endif
+
+// the largest power of two dividing size, capped at SLOT_ALIGN
+static size_t swiss_natural_align(size_t size)
+{
+    size_t align = size & (~size + 1);
+    return align < SLOT_ALIGN ? align : SLOT_ALIGN;
+}
+
+static inline uint8_t *swiss_slot(const swiss_map_t *map, size_t index)
+{
+    return map->slots + index * map->slot_size;
+}
+
+// writes a tag, keeping the mirrored copy of the first group in step
+static inline void swiss_set_ctrl(swiss_map_t *map, size_t index, uint8_t tag)
+{
+    map->ctrl[index] = tag;
+    if (index < SWISS_MAP_GROUP_WIDTH)
+        map->ctrl[map->capacity + index] = tag;
+}
+
+// 7/8 of the slots may be full; a group with at least one EMPTY tag always ends a probe
+static inline size_t swiss_max_load(size_t capacity)
+{
+    return capacity - capacity / 8;
+}
+
+// ctrl and slots share one allocation; ctrl starts it so freeing ctrl frees both
+static bool swiss_map_alloc(swiss_map_t *map, size_t capacity)
+{
+    size_t ctrl_bytes = ALIGN_UP(capacity + SWISS_MAP_GROUP_WIDTH, SLOT_ALIGN);
+    uint8_t *block = malloc(ctrl_bytes + capacity * map->slot_size);
+    if (!block)
+        return false;
+
+    memset(block, SWISS_MAP_CTRL_EMPTY, capacity + SWISS_MAP_GROUP_WIDTH);
+
+    map->ctrl = block;
+    map->slots = block + ctrl_bytes;
+    map->capacity = capacity;
+    map->size = 0;
+    map->growth_left = swiss_max_load(capacity);
+    return true;
+}
+
+// triangular probing over groups: the start moves by 16, 32, 48, ... tags, which visits every
+// group of a power-of-two table exactly once before repeating
+// returns the slot holding key, or capacity if there is none
+static size_t swiss_map_find(const swiss_map_t *map, const void *key, uint64_t hash)
+{
+    size_t mask = map->capacity - 1;
+    size_t pos = swiss_h1(hash) & mask;
+    uint8_t h2 = swiss_h2(hash);
+
+    for (size_t step = SWISS_MAP_GROUP_WIDTH; step <= map->capacity; step += SWISS_MAP_GROUP_WIDTH)
+    {
+        const uint8_t *group = map->ctrl + pos;
+
+        for (uint32_t match = swiss_group_match(group, h2); match; match &= match - 1)
+        {
+            size_t index = (pos + (size_t)__builtin_ctz(match)) & mask;
+            if (!memcmp(swiss_slot(map, index), key, map->key_size))
+                return index;
+        }
+
+        if (swiss_group_match_empty(group))
+            return map->capacity;
+
+        pos = (pos + step) & mask;
+    }
+
+    return map->capacity;
+}
+
+// first EMPTY or DELETED slot on hash's probe sequence; the load factor guarantees there is one
+static size_t swiss_map_find_free(const swiss_map_t *map, uint64_t hash)
+{
+    size_t mask = map->capacity - 1;
+    size_t pos = swiss_h1(hash) & mask;
+
+    for (size_t step = SWISS_MAP_GROUP_WIDTH;; step += SWISS_MAP_GROUP_WIDTH)
+    {
+        uint32_t free_mask = swiss_group_match_empty_or_deleted(map->ctrl + pos);
+        if (free_mask)
+            return (pos + (size_t)__builtin_ctz(free_mask)) & mask;
+
+        pos = (pos + step) & mask;
+    }
+}
+
+// rebuilds the table at new_capacity, dropping every DELETED tag on the way
+static bool swiss_map_rehash(swiss_map_t *map, size_t new_capacity)
+{
+    swiss_map_t old = *map;
+
+    if (!swiss_map_alloc(map, new_capacity))
+    {
+        *map = old;
+        return false;
+    }
+
+    for (size_t index = 0; index < old.capacity; index++)
+    {
+        if (old.ctrl[index] & 0x80)
+            continue;
+
+        const uint8_t *slot = old.slots + index * old.slot_size;
+        uint64_t hash = swiss_map_hash(map, slot);
+        size_t target = swiss_map_find_free(map, hash);
+
+        swiss_set_ctrl(map, target, swiss_h2(hash));
+        memcpy(swiss_slot(map, target), slot, map->slot_size);
+    }
+
+    map->size = old.size;
+    map->growth_left -= old.size;
+
+    free(old.ctrl);
+    return true;
+}
+
+swiss_map_t *swiss_map_create(size_t key_size, size_t value_size)
+{
+    if (!key_size || !value_size)
+        return NULL;
+
+    swiss_map_t *map = malloc(sizeof(swiss_map_t));
+    if (!map)
+        return NULL;
+
+    map->key_size = key_size;
+    map->value_size = value_size;
+    // slots are packed as tight as the alignment their sizes imply, so a 4-byte key and value take 8 bytes
+    size_t key_align = swiss_natural_align(key_size);
+    size_t value_align = swiss_natural_align(value_size);
+    map->value_offset = ALIGN_UP(key_size, value_align);
+    map->slot_size = ALIGN_UP(map->value_offset + value_size, key_align > value_align ? key_align : value_align);
+    map->hash_fn = HASH_FN_DEFAULT;
+    map->seed = HASH_DEFAULT_SEED;
+
+    if (!swiss_map_alloc(map, SWISS_MAP_MIN_CAPACITY))
+    {
+        free(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+void swiss_map_destroy(swiss_map_t *map)
+{
+    if (!map)
+        return;
+
+    free(map->ctrl);
+    free(map);
+}
+
+bool swiss_map_set_hash_fn(swiss_map_t *map, hash_fn_t hash_fn, uint64_t seed)
+{
+    if (!map || !hash_fn || map->size)
+        return false;
+
+    map->hash_fn = hash_fn;
+    map->seed = seed;
+    return true;
+}
+
+bool swiss_map_insert(swiss_map_t *map, const void *key, const void *value)
+{
+    if (!map || !key || !value)
+        return false;
+
+    uint64_t hash = swiss_map_hash(map, key);
+
+    size_t index = swiss_map_find(map, key, hash);
+    if (index != map->capacity)
+    {
+        memcpy(swiss_slot(map, index) + map->value_offset, value, map->value_size);
+        return true;
+    }
+
+    index = swiss_map_find_free(map, hash);
+
+    // reusing a DELETED slot costs no growth; filling an EMPTY one does
+    if (map->ctrl[index] == SWISS_MAP_CTRL_EMPTY && !map->growth_left)
+    {
+        // mostly tombstones: rebuild in place at the same size instead of doubling
+        size_t new_capacity = map->size <= swiss_max_load(map->capacity) / 2 ? map->capacity : map->capacity * 2;
+        if (!swiss_map_rehash(map, new_capacity))
+            return false;
+
+        index = swiss_map_find_free(map, hash);
+    }
+
+    if (map->ctrl[index] == SWISS_MAP_CTRL_EMPTY)
+        map->growth_left--;
+
+    swiss_set_ctrl(map, index, swiss_h2(hash));
+
+    uint8_t *slot = swiss_slot(map, index);
+    memcpy(slot, key, map->key_size);
+    memcpy(slot + map->value_offset, value, map->value_size);
+
+    map->size++;
+    return true;
+}
+
+bool swiss_map_remove(swiss_map_t *map, const void *key)
+{
+    if (!map || !key)
+        return false;
+
+    size_t index = swiss_map_find(map, key, swiss_map_hash(map, key));
+    if (index == map->capacity)
+        return false;
+
+    // if no 16-tag window through this slot was ever full, no probe can have passed over it,
+    // so it can go straight back to EMPTY; otherwise it has to stay as a tombstone
+    size_t mask = map->capacity - 1;
+    uint32_t empty_before = swiss_group_match_empty(map->ctrl + ((index - SWISS_MAP_GROUP_WIDTH) & mask));
+    uint32_t empty_after = swiss_group_match_empty(map->ctrl + index);
+
+    bool was_never_full = empty_before && empty_after &&
+                          (size_t)__builtin_ctz(empty_after) + (size_t)__builtin_clz(empty_before << (32 - SWISS_MAP_GROUP_WIDTH)) < SWISS_MAP_GROUP_WIDTH;
+
+    if (was_never_full)
+    {
+        swiss_set_ctrl(map, index, SWISS_MAP_CTRL_EMPTY);
+        map->growth_left++;
+    }
+    else
+    {
+        swiss_set_ctrl(map, index, SWISS_MAP_CTRL_DELETED);
+    }
+
+    map->size--;
+    return true;
+}
+
+const void *swiss_map_get_ptr(swiss_map_t *map, const void *key)
+{
+    if (!map || !key)
+        return NULL;
+
+    size_t index = swiss_map_find(map, key, swiss_map_hash(map, key));
+    if (index == map->capacity)
+        return NULL;
+
+    return swiss_slot(map, index) + map->value_offset;
+}
+
+bool swiss_map_search(swiss_map_t *map, const void *key, void *value)
+{
+    const void *stored = swiss_map_get_ptr(map, key);
+    if (!stored)
+        return false;
+
+    if (value)
+        memcpy(value, stored, map->value_size);
+    return true;
+}
+
+size_t swiss_map_size(const swiss_map_t *map)
+{
+    return map ? map->size : 0;
+}